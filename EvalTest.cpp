@@ -9,6 +9,8 @@
 
 #include <cinttypes>
 #include "core/BitBoard.h"
+#include "core/BitBoardTest.h"
+#include "core/QPosition.h"
 #include "Evaluator.h"
 #include "n64/flips.h"
 #include "n64/test.h"
@@ -75,3 +77,44 @@ void GoldenValueEvalTest() {
         TEST(e.expectedEval == eval->EvalMobs(pp, static_cast<u4>(bitCount(moveBits)), static_cast<u4>(bitCount(enemyMoveBits))));
     }
 }
+
+// Check that the implementations of EvalMobs() give the same values as the portable one, on the
+// positions of the test games from both sides. Implementations the processor doesn't support are
+// skipped.
+void EvalMobsImplementationTest() {
+    const CEvaluator* const eval = CEvaluator::FindEvaluator('J', 'A');
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__MINGW32__)
+    const bool fBmi2 = __builtin_cpu_supports("bmi2");
+    const bool fAvx2 = fBmi2 && __builtin_cpu_supports("avx2");
+#endif
+
+    const std::vector<COsGame> games = LoadTestGames();
+    for (size_t iGame = 0; iGame < games.size() && iGame < 100; ++iGame) {
+        const COsGame& game = games[iGame];
+        Pos2 pos2;
+        pos2.Initialize(CQPosition(game.GetPosStart().board).BitBoard(), game.GetPosStart().board.IsBlackMove());
+        for (size_t iMove = 0; iMove < game.ml.size(); ++iMove) {
+            const CMove move = game.ml[iMove].mv;
+            if (move.IsPass())
+                pos2.PassBB();
+            else
+                pos2.MakeMoveBB(move.Square());
+            if (!pos2.NEmpty())
+                break;
+
+            u4 nMovesPlayer, nMovesOpponent;
+            pos2.CalcMobility(nMovesPlayer, nMovesOpponent);
+            for (int side = 0; side < 2; ++side) {
+                const CValue expected = eval->EvalMobsScalar(pos2, nMovesPlayer, nMovesOpponent);
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__MINGW32__)
+                if (fBmi2)
+                    assertEquals(expected, eval->EvalMobsBmi2(pos2, nMovesPlayer, nMovesOpponent));
+                if (fAvx2)
+                    assertEquals(expected, eval->EvalMobsAvx2(pos2, nMovesPlayer, nMovesOpponent));
+#endif
+                pos2.PassBase();
+                std::swap(nMovesPlayer, nMovesOpponent);
+            }
+        }
+    }
+}
@@ -6,6 +6,7 @@
 // Evaluator source code
 #include <arpa/inet.h>
 #include <sstream>
+#include <vector>
 #if defined(__GNUC__) && defined(__x86_64__) && !defined(__MINGW32__)
 #include <x86intrin.h>
 #endif
@@ -77,6 +78,36 @@ std::string CEvaluator::FNBase(char evaluatorType, char coeffSet) {
 //////////////////////////////////////////////////////
 
 
+// offsetJs for coefficients. Some maps' coefficients are added to another map's when they are
+//    loaded, so they have no table: 2x4 corners go into the 2x5 corners, edges into the edge+2X
+//    patterns, and parity into the mover's mobility.
+constexpr int offsetJR2 = 0, sizeJR2 = 6561,
+offsetJR3 = offsetJR2 + sizeJR2, sizeJR3 = 6561,
+offsetJR4 = offsetJR3 + sizeJR3, sizeJR4 = 6561,
+offsetJD8 = offsetJR4 + sizeJR4, sizeJD8 = 6561,
+offsetJD7 = offsetJD8 + sizeJD8, sizeJD7 = 2187,
+offsetJD6 = offsetJD7 + sizeJD7, sizeJD6 = 729,
+offsetJD5 = offsetJD6 + sizeJD6, sizeJD5 = 243,
+offsetJTriangle = offsetJD5 + sizeJD5, sizeJTriangle = 9 * 6561,
+offsetJC5 = offsetJTriangle + sizeJTriangle, sizeJC5 = 6561 * 9,
+offsetJEX = offsetJC5 + sizeJC5, sizeJEX = 6561 * 9,
+offsetJMP = offsetJEX + sizeJEX, sizeJMP = 64,
+offsetJMO = offsetJMP + sizeJMP, sizeJMO = 64,
+offsetJPMP = offsetJMO + sizeJMO, sizeJPMP = 64,
+offsetJPMO = offsetJPMP + sizeJPMP, sizeJPMO = 64,
+nSetCoeffsJ = offsetJPMO + sizeJPMO;
+
+//! Offset of each map's coefficients in a set, or -1 if the map has no table
+static const int setOffsetsJ[nMapsJ] = {
+    -1, offsetJR2, offsetJR3, offsetJR4, offsetJD8, offsetJD7, offsetJD6, offsetJD5,
+    offsetJTriangle, -1, offsetJC5, offsetJEX, offsetJMP, offsetJMO, offsetJPMP, offsetJPMO, -1
+};
+
+// offsets of the pot mob tables, by line length and for the triangles.
+//    Lines of the same length have the same pot mobs, whichever line they are.
+constexpr int offsetPM8 = 0, offsetPM7 = offsetPM8 + 6561, offsetPM6 = offsetPM7 + 2187,
+offsetPM5 = offsetPM6 + 729, offsetPMTriangle = offsetPM5 + 243, nPotMobs = offsetPMTriangle + 9 * 6561;
+
 //! Read in Evaluator coefficients from a coefficient file
 //!
 //! If the file's fParams is 14, coefficients are stored as floats and are in units of stones
@@ -86,8 +117,6 @@ std::string CEvaluator::FNBase(char evaluatorType, char coeffSet) {
 CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
     int map,  iFile, coeffStart, packedCoeff;
     int nIDs, nConfigs, id, config, cid;
-    uint32_t configpm1, configpm2, mapsize;
-    bool fHasPotMobs;
     float* rawCoeffs=0;    //!< for use with raw (float) coeffs
     i2* i2Coeffs=0;        //!< for use with converted (packed) coeffs
     TCoeff coeff;
@@ -98,6 +127,38 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
     char cCoeffSet=fnBase.end()[-1];
 
 
+    // allocate memory for all the coefficient sets in one block, so it can be backed by huge pages
+    coeffBlockSize=size_t(nFiles)*2*nSetCoeffsJ*sizeof(i2);
+    TPageMode pageMode;
+    coeffBlock=reinterpret_cast<i2*>(LargeAlloc(coeffBlockSize, pageMode));
+    CHECKNEW(coeffBlock != NULL);
+    std::cerr << "Evaluator coefficients: " << (coeffBlockSize>>10) << " KB, " << PageModeName(pageMode) << "\n";
+
+    // Pot mobs depend only on the configuration, so all the sets share them.
+    //    Each entry is (pot mob 1 << 8) + pot mob 2.
+    potMobs=new u2[nPotMobs];
+    CHECKNEW(potMobs != NULL);
+    const int potMobMaps[]={R1J, D7J, D6J, D5J, C4J};
+    const int potMobOffsets[]={offsetPM8, offsetPM7, offsetPM6, offsetPM5, offsetPMTriangle};
+    for (int i=0; i<5; i++) {
+        map=potMobMaps[i];
+        for (config=0; config<mapsJ[map].NConfigs(); config++) {
+            u4 configpm1, configpm2;
+            if (map==C4J) {
+                configpm1=configToPotMobTriangle[0][config];
+                configpm2=configToPotMobTriangle[1][config];
+            }
+            else {
+                configpm1=configToPotMob[0][mapsJ[map].size][config];
+                configpm2=configToPotMob[1][mapsJ[map].size][config];
+            }
+            potMobs[potMobOffsets[i]+config]=u2((configpm1<<8) | configpm2);
+        }
+    }
+
+    // coefficients of one set, laid out by coeffStartsJ, before they are packed into the set's tables
+    std::vector<TCoeff> setCoeffs(nCoeffsJ);
+
     // read in sets
     nSets=0;
     for (iFile=0; iFile<nFiles; iFile++) {
@@ -129,9 +190,8 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
         nSubsets=2;
 
         for (iSubset=0; iSubset<nSubsets; iSubset++) {
-            // allocate memory for the black and white versions of the coefficients
-            coeffs[nSets]=new TCoeff[nCoeffsJ];
-            CHECKNEW(coeffs[nSets] != NULL);
+            // memory for the black and white versions of the coefficients
+            coeffs[nSets]=coeffBlock+size_t(nSets)*nSetCoeffsJ;
 
             // put the coefficients in the proper place
             for (map=0; map<nMapsJ; map++) {
@@ -139,7 +199,6 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
                 // inital calculations
                 nIDs=mapsJ[map].NIDs();
                 nConfigs=mapsJ[map].NConfigs();
-                mapsize=mapsJ[map].size;
                 coeffStart=coeffStartsJ[map];
 
                 // get raw coefficients from file
@@ -168,7 +227,6 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
                         }
                     }
                     
-                    // coeff value has first 2 bytes=coeff, 3rd byte=potmob1, 4th byte=potmob2
                     if (map<M1J) {    // pattern maps
                         // restrict the coefficient to 2 bytes
                         if (coeff>0x3FFF)
@@ -177,33 +235,12 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
                             packedCoeff=-0x3FFF;
                         else
                             packedCoeff=coeff;
-                        
-                        // get linear pot mob info
-                        if (map<=D5J) {    // straight-line maps
-                            fHasPotMobs=true;
-                            configpm1=configToPotMob[0][mapsize][config];
-                            configpm2=configToPotMob[1][mapsize][config];
-                        }
-                        
-                        else if (map==C4J) {    // corner triangle maps
-                            fHasPotMobs=true;
-                            configpm1=configToPotMobTriangle[0][config];
-                            configpm2=configToPotMobTriangle[1][config];
-                        }
-
-                        else {    // 2x4, 2x5, edge+2X
-                            fHasPotMobs=false;
-                        }
-
-                        // pack coefficient and pot mob together
-                        if (fHasPotMobs)
-                            packedCoeff=(packedCoeff<<16) | (configpm1<<8) | (configpm2);                        
 
-                        coeffs[nSets][cid]=packedCoeff;
+                        setCoeffs[cid]=packedCoeff;
                     }
                     
                     else {        // non-pattern maps
-                        coeffs[nSets][cid]=coeff;
+                        setCoeffs[cid]=coeff;
                     }
                 }
 
@@ -215,16 +252,39 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
             TCoeff* pcf2x4, *pcf2x5;
             TConfig c2x4;
 
-            pcf2x4=&(coeffs[nSets][coeffStartsJ[C2x4J]]);
-            pcf2x5=&(coeffs[nSets][coeffStartsJ[C2x5J]]);
+            pcf2x4=&(setCoeffs[coeffStartsJ[C2x4J]]);
+            pcf2x5=&(setCoeffs[coeffStartsJ[C2x5J]]);
             // fold coefficients in
             for (config=0; config<9*6561; config++) {
                 c2x4=configs2x5To2x4[config];
                 pcf2x5[config]+=pcf2x4[c2x4];
             }
-            // zero out 2x4 coefficients
-            for (config=0;config<6561; config++) {
-                pcf2x4[config]=0;
+
+            // fold edges into edge+2X patterns: an edge+2X configuration is
+            //    X-square + 3*edge + 3^9*X-square, and is always looked up with its edge
+            const TCoeff* pcfR1=&(setCoeffs[coeffStartsJ[R1J]]);
+            TCoeff* pcfEX=&(setCoeffs[coeffStartsJ[CR1XXJ]]);
+            for (config=0; config<9*6561; config++) {
+                pcfEX[config]+=pcfR1[(config/3)%6561];
+            }
+
+            // fold parity into the mover's mobility: this set only evaluates positions
+            //    with one parity of empties (see below)
+            const TCoeff parity=setCoeffs[coeffStartsJ[PARJ]+(iSubset^1)];
+            for (config=0; config<mapsJ[M1J].NConfigs(); config++) {
+                setCoeffs[coeffStartsJ[M1J]+config]+=parity;
+            }
+
+            // pack the coefficients into the set's 16-bit tables
+            for (map=0; map<nMapsJ; map++) {
+                if (setOffsetsJ[map]<0)
+                    continue;
+                for (config=0; config<mapsJ[map].NConfigs(); config++) {
+                    coeff=setCoeffs[coeffStartsJ[map]+config];
+                    if (coeff!=i2(coeff))
+                        throw std::string("coefficient out of range in coefficients file ")+fn;
+                    coeffs[nSets][setOffsetsJ[map]+config]=i2(coeff);
+                }
             }
 
             // Set the pcoeffs array and the fParameters
@@ -242,12 +302,9 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
 }
 
 CEvaluator::~CEvaluator() {
-    int set;
-
-    // delete the coeffs array
-    for (set=0; set<nSets; set++) {
-        delete[] coeffs[set];
-    }
+    // delete the coeffs arrays
+    LargeFree(coeffBlock, coeffBlockSize);
+    delete[] potMobs;
 }
 
 ////////////////////////////////////////
@@ -261,88 +318,78 @@ CEvaluator::~CEvaluator() {
 // only works with OLD_EVAL set to 1 (slower old version)
 const int iDebugEval=0;
 
-INLINE_HINT TCoeff ConfigValue(const TCoeff* pcmove, TConfig config, int map, int offset) {
+INLINE_HINT TCoeff ConfigValue(const i2* pcmove, TConfig config, int map, int offset) {
     TCoeff value=pcmove[config+offset];
     if (iDebugEval>1)
         printf("Config: %5lu, Id: %5hu, Value: %4d\n", config, mapsJ[map].ConfigToID(u2(config)), value);
     return value;
 }
 
-INLINE_HINT TCoeff PatternValue(TConfig configs[], const TCoeff* pcmove, int pattern, int map, int offset) {
+INLINE_HINT TCoeff PatternValue(TConfig configs[], const i2* pcmove, int pattern, int map, int offset) {
     TConfig config=configs[pattern];
     TCoeff value=pcmove[config+offset];
     if (iDebugEval>1)
-        printf("Pattern: %2d - Config: %5lu, Id: %5hu, Value: %4d (pms %2d, %2d)\n",
-                pattern, config, mapsJ[map].ConfigToID(u2(config)), value>>16, (value>>8)&0xFF, value&0xFF);
+        printf("Pattern: %2d - Config: %5lu, Id: %5hu, Value: %4d\n",
+                pattern, config, mapsJ[map].ConfigToID(u2(config)), value);
     return value;
 }
 
-INLINE_HINT TCoeff ConfigPMValue(const TCoeff* pcmove, TConfig config, int map, int offset) {
-    TCoeff value=pcmove[config+offset];
+// Add the coefficient of a configuration to value and its packed pot mobs to potMobs
+INLINE_HINT void ConfigPMValue(TCoeff& value, TCoeff& potMobs, const i2* pcmove, const u2* pmmove, TConfig config) {
+    value+=pcmove[config];
+    potMobs+=pmmove[config];
     if (iDebugEval>1)
-        printf("Config: %5lu, Id: %5hu, Value: %4d (pms %2d, %2d)\n",
-                config, mapsJ[map].ConfigToID(u2(config)), value>>16, (value>>8)&0xFF, value&0xFF);
-    return value;
+        printf("Config: %5lu, Value: %4d (pms %2d, %2d)\n",
+                config, pcmove[config], pmmove[config]>>8, pmmove[config]&0xFF);
 }
 
-
-// offsetJs for coefficients
-constexpr int offsetJR1 = 0, sizeJR1 = 6561,
-offsetJR2 = offsetJR1 + sizeJR1, sizeJR2 = 6561,
-offsetJR3 = offsetJR2 + sizeJR2, sizeJR3 = 6561,
-offsetJR4 = offsetJR3 + sizeJR3, sizeJR4 = 6561,
-offsetJD8 = offsetJR4 + sizeJR4, sizeJD8 = 6561,
-offsetJD7 = offsetJD8 + sizeJD8, sizeJD7 = 2187,
-offsetJD6 = offsetJD7 + sizeJD7, sizeJD6 = 729,
-offsetJD5 = offsetJD6 + sizeJD6, sizeJD5 = 243,
-offsetJTriangle = offsetJD5 + sizeJD5, sizeJTriangle = 9 * 6561,
-offsetJC4 = offsetJTriangle + sizeJTriangle, sizeJC4 = 6561,
-offsetJC5 = offsetJC4 + sizeJC4, sizeJC5 = 6561 * 9,
-offsetJEX = offsetJC5 + sizeJC5, sizeJEX = 6561 * 9,
-offsetJMP = offsetJEX + sizeJEX, sizeJMP = 64,
-offsetJMO = offsetJMP + sizeJMP, sizeJMO = 64,
-offsetJPMP = offsetJMO + sizeJMO, sizeJPMP = 64,
-offsetJPMO = offsetJPMP + sizeJPMP, sizeJPMO = 64,
-offsetJPAR = offsetJPMO + sizeJPMO; // sizeJPAR = 2;
-
 // value all the edge patterns. return the sum of the values.
-static INLINE_HINT TCoeff ValueEdgePatternsJ(const TCoeff* pcmove, TConfig config1, TConfig config2) {
+static INLINE_HINT TCoeff ValueEdgePatternsJ(const i2* pcmove, TConfig config1, TConfig config2) {
     u4 configs2x5;
     TCoeff value;
 
     value=0;
-    configs2x5 = row1To2x5[config1] + row2To2x5[config2];
+    const uint64_t row2=row2To2x5AndXX[config2];
+    configs2x5 = row1To2x5[config1] + u4(row2);
     value+=ConfigValue(pcmove, configs2x5&0xFFFF, C2x5J, offsetJC5);
     value+=ConfigValue(pcmove, configs2x5>>16,    C2x5J, offsetJC5);
-    value+=ConfigValue(pcmove, config1 * 3 +row2ToXX[config2],CR1XXJ, offsetJEX);
+    value+=ConfigValue(pcmove, config1 * 3 + u4(row2>>32),CR1XXJ, offsetJEX);
 
-    // in J-configs, the values are multiplied by 65536
-    //assert((value&0xFFFF)==0);
     return value;
 }
 
-// value all the triangle patterns. return the sum of the values.
-static INLINE_HINT TCoeff ValueTrianglePatternsJ(const TCoeff* pcmove, TConfig config1, TConfig config2, TConfig config3, TConfig config4) {
+// value all the triangle patterns, adding their values to value and their pot mobs to potMobs.
+static INLINE_HINT void ValueTrianglePatternsJ(TCoeff& value, TCoeff& potMobs, const i2* pcmove, const u2* pmmove, TConfig config1, TConfig config2, TConfig config3, TConfig config4) {
     u4 configsTriangle;
-    TCoeff value;
-
-    value=0;
 
     configsTriangle=row1ToTriangle[config1]+row2ToTriangle[config2]+row3ToTriangle[config3]+row4ToTriangle[config4];
-    value+=ConfigPMValue(pcmove, configsTriangle&0xFFFF, C4J, offsetJTriangle);
-    value+=ConfigPMValue(pcmove, configsTriangle>>16,    C4J, offsetJTriangle);
+    ConfigPMValue(value, potMobs, pcmove+offsetJTriangle, pmmove+offsetPMTriangle, configsTriangle&0xFFFF);
+    ConfigPMValue(value, potMobs, pcmove+offsetJTriangle, pmmove+offsetPMTriangle, configsTriangle>>16);
+}
 
-    return value;
+// Final value from the pattern and mobility value and the pot mobs summed over the patterns.
+//    potMobs is the sum of (pot mob 1 << 8) + pot mob 2; anything that carries out of its low
+//    16 bits is counted in the value, as if the pot mobs were packed below the coefficients.
+static INLINE_HINT CValue ValuePotMobsJ(const i2* pcoeffs, TCoeff value, TCoeff potMobs) {
+    // Take apart packed information about pot mobilities
+    unsigned nPMO=(potMobs>>8) & 0xFF;
+    unsigned nPMP=potMobs&0xFF;
+    nPMO=(nPMO+potMobAdd)>>potMobShift;
+    nPMP=(nPMP+potMobAdd)>>potMobShift;
+    value+=potMobs>>16;
+
+    // pot mobility
+    value += ConfigValue(pcoeffs, nPMP, PM1J, offsetJPMP);
+    value += ConfigValue(pcoeffs, nPMO, PM2J, offsetJPMO);
+
+    return CValue(value);
 }
 
 
 // pos2 evaluators
-#if defined(__GNUC__) && defined(__x86_64__) && !defined(__MINGW32__)
-__attribute__((target("default")))
-#endif
-CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+CValue CEvaluator::EvalMobsScalar(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
     CBitBoard bb = pos2.GetBB();
-    TCoeff *const pcoeffs = this->pcoeffs[pos2.NEmpty()];
+    const i2 *const pcoeffs = this->pcoeffs[pos2.NEmpty()];
 // This function implements a linear pattern evaluator. 
 //
 // Most of the work is in extracting base-3 patterns such as rows, columns,
@@ -352,8 +399,8 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
 //
 // The other three components of the static evaluation are:
 // * mobility (nMovesPlayer and nMovesOpponent are passed to this function)
-// * potential mobility (the potential mobility values are baked into the
-//   base-3 patterns, as the lower-order bits of the resulting value)
+// * potential mobility (the base-3 patterns also index the potMobs table,
+//   which gives each line and triangle configuration's potential mobilities)
 // * parity
 // 
 // There are several strategies for extracting the patterns:
@@ -378,15 +425,18 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
 // their corresponding pattern values. The rows, on the other hand, are needed
 // for corner areas.
 // 
-    // Value has a lower 16 bit component and a higher one. The lower bits are used to
-    // unpack potmob values (potential mobility)
+    // The pot mobs of the patterns are summed separately from the values, packed as
+    // (pot mob 1 << 8) + pot mob 2, and looked up at the end.
     TCoeff value = 0;
+    TCoeff potMobs = 0;
+    const u2* const pm8 = this->potMobs+offsetPM8;
+    const u2* const pm7 = this->potMobs+offsetPM7;
+    const u2* const pm6 = this->potMobs+offsetPM6;
+    const u2* const pm5 = this->potMobs+offsetPM5;
 
-    // mobility
-    value += (ConfigValue(pcoeffs, nMovesPlayer, M1J, offsetJMP) +
-              ConfigValue(pcoeffs, nMovesOpponent, M2J, offsetJMO) +
-    // parity
-              ConfigValue(pcoeffs, pos2.NEmpty()&1, PARJ, offsetJPAR)) << 16;
+    // mobility. The mover's mobility coefficients include the parity coefficient.
+    value += ConfigValue(pcoeffs, nMovesPlayer, M1J, offsetJMP) +
+             ConfigValue(pcoeffs, nMovesOpponent, M2J, offsetJMO);
 
     uint64_t empty = bb.empty;
     uint64_t mover = bb.mover;
@@ -401,28 +451,28 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
     base2ToBase3Table[EXTRACT_BITS_U64(empty, (START), (COUNT), (STEP))] + \
     base2ToBase3Table[EXTRACT_BITS_U64(mover, (START), (COUNT), (STEP))] * 2
 
-    const TCoeff* const pD5 = pcoeffs+offsetJD5;
-    const TCoeff* const pD6 = pcoeffs+offsetJD6;
-    const TCoeff* const pD7 = pcoeffs+offsetJD7;
-    const TCoeff* const pD8 = pcoeffs+offsetJD8;
+    const i2* const pD5 = pcoeffs+offsetJD5;
+    const i2* const pD6 = pcoeffs+offsetJD6;
+    const i2* const pD7 = pcoeffs+offsetJD7;
+    const i2* const pD8 = pcoeffs+offsetJD8;
 
     // Diagonals of type A run NWSE, with a bit step of 9.
     // Type B diagonals run NESW, with a bit step of 7.
     // Diag 8A and 8B
-    value += pD8[BB_EXTRACT_STEP_PATTERN(0, 8, 9)];
+    ConfigPMValue(value, potMobs, pD8, pm8, BB_EXTRACT_STEP_PATTERN(0, 8, 9));
     uint32_t Diag8B =
         base2ToBase3Table[extract_second_diagonal(empty)] +
         base2ToBase3Table[extract_second_diagonal(mover)] * 2;
-    value += pD8[Diag8B]; 
+    ConfigPMValue(value, potMobs, pD8, pm8, Diag8B); 
 
-    value += pD7[BB_EXTRACT_STEP_PATTERN(1, 7, 9)];
-    value += pD7[BB_EXTRACT_STEP_PATTERN(8, 7, 9)];
-    value += pD7[BB_EXTRACT_STEP_PATTERN(6, 7, 7)];
-    value += pD7[BB_EXTRACT_STEP_PATTERN(15, 7, 7)];
+    ConfigPMValue(value, potMobs, pD7, pm7, BB_EXTRACT_STEP_PATTERN(1, 7, 9));
+    ConfigPMValue(value, potMobs, pD7, pm7, BB_EXTRACT_STEP_PATTERN(8, 7, 9));
+    ConfigPMValue(value, potMobs, pD7, pm7, BB_EXTRACT_STEP_PATTERN(6, 7, 7));
+    ConfigPMValue(value, potMobs, pD7, pm7, BB_EXTRACT_STEP_PATTERN(15, 7, 7));
 
     // Diag6 B1 and B2 
-    value += pD6[BB_EXTRACT_STEP_PATTERN(5, 6, 7)];
-    value += pD6[BB_EXTRACT_STEP_PATTERN(23, 6, 7)];
+    ConfigPMValue(value, potMobs, pD6, pm6, BB_EXTRACT_STEP_PATTERN(5, 6, 7));
+    ConfigPMValue(value, potMobs, pD6, pm6, BB_EXTRACT_STEP_PATTERN(23, 6, 7));
 
     // The 0x2030486ca2f300 multiplier will perform the bit gather +
     // base 3 conversion for the 6-long diagonal starting on bit 2, with
@@ -435,20 +485,20 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
     uint64_t Diag6A1 =
         (((empty & meta_repeated_bit<uint64_t, 2, 6, 9>::value) * 0x2030486ca2f300) >> 55) +
         2 * (((mover & meta_repeated_bit<uint64_t, 2, 6, 9>::value) * 0x2030486ca2f300) >> 55);
-    value += pD6[Diag6A1];
+    ConfigPMValue(value, potMobs, pD6, pm6, Diag6A1);
     uint64_t Diag6A2 =
         ((((empty & meta_repeated_bit<uint64_t, 16, 6, 9>::value) >> 14) * 0x2030486ca2f300) >> 55) +
         2 * ((((mover & meta_repeated_bit<uint64_t, 16, 6, 9>::value) >> 14) * 0x2030486ca2f300) >> 55);
-    value += pD6[Diag6A2];
+    ConfigPMValue(value, potMobs, pD6, pm6, Diag6A2);
 
     uint64_t Diag5A1 =
          ((((empty & meta_repeated_bit<uint64_t, 3, 5, 9>::value) >> 1) * 0x2030486ca2f300) >> 55) +
          2 * ((((mover & meta_repeated_bit<uint64_t, 3, 5, 9>::value) >> 1) * 0x2030486ca2f300) >> 55);
-    value += pD5[Diag5A1];
+    ConfigPMValue(value, potMobs, pD5, pm5, Diag5A1);
     uint64_t Diag5A2 =
          ((((empty & meta_repeated_bit<uint64_t, 24, 5, 9>::value) >> 22) * 0x2030486ca2f300) >> 55) +
          2 * ((((mover & meta_repeated_bit<uint64_t, 24, 5, 9>::value) >> 22) * 0x2030486ca2f300) >> 55);
-    value += pD5[Diag5A2];
+    ConfigPMValue(value, potMobs, pD5, pm5, Diag5A2);
 
     // The 0x20c49ba2000000 multiplier performs bit gather + base 3 conversion
     // for the 5-long diagonal starting on bit 4, with a step of 7 bits 5(a.k.a.
@@ -456,43 +506,42 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
     uint64_t Diag5B1 =  
          ((((empty & meta_repeated_bit<uint64_t, 4, 5, 7>::value)) * 0x20c49ba2000000) >> 57) +
          2 * ((((mover & meta_repeated_bit<uint64_t, 4, 5, 7>::value)) * 0x20c49ba2000000) >> 57);
-    value += pD5[Diag5B1];
+    ConfigPMValue(value, potMobs, pD5, pm5, Diag5B1);
     uint64_t Diag5B2 = 
          ((((empty & meta_repeated_bit<uint64_t, 31, 5, 7>::value) >> 27) * 0x20c49ba2000000) >> 57) +
          2 * ((((mover & meta_repeated_bit<uint64_t, 31, 5, 7>::value) >> 27) * 0x20c49ba2000000) >> 57);
-    value += pD5[Diag5B2];
+    ConfigPMValue(value, potMobs, pD5, pm5, Diag5B2);
 #undef BB_EXTRACT_STEP_PATTERN
 
-    const TCoeff* const pR1 = pcoeffs+offsetJR1;
-    const TCoeff* const pR2 = pcoeffs+offsetJR2;
-    const TCoeff* const pR3 = pcoeffs+offsetJR3;
-    const TCoeff* const pR4 = pcoeffs+offsetJR4;
+    const i2* const pR2 = pcoeffs+offsetJR2;
+    const i2* const pR3 = pcoeffs+offsetJR3;
+    const i2* const pR4 = pcoeffs+offsetJR4;
 
 #define BB_EXTRACT_ROW_PATTERN(ROW) \
     base2ToBase3Table[(empty >> (8 * (ROW))) & 0xff] + \
     base2ToBase3Table[(mover >> (8 * (ROW))) & 0xff] * 2
 
     TConfig Row0 = BB_EXTRACT_ROW_PATTERN(0);
-    value += pR1[Row0];
+    potMobs += pm8[Row0];     // the edge's coefficient is in its edge+2X coefficient
     TConfig Row1 = BB_EXTRACT_ROW_PATTERN(1);
-    value += pR2[Row1];
-    value += ValueEdgePatternsJ(pcoeffs, Row0, Row1) << 16;
+    ConfigPMValue(value, potMobs, pR2, pm8, Row1);
+    value += ValueEdgePatternsJ(pcoeffs, Row0, Row1);
     TConfig Row2 = BB_EXTRACT_ROW_PATTERN(2);
-    value += pR3[Row2];
+    ConfigPMValue(value, potMobs, pR3, pm8, Row2);
     TConfig Row3 = BB_EXTRACT_ROW_PATTERN(3);
-    value += pR4[Row3];
-    value += ValueTrianglePatternsJ(pcoeffs, Row0, Row1, Row2, Row3);
+    ConfigPMValue(value, potMobs, pR4, pm8, Row3);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, Row0, Row1, Row2, Row3);
 
     TConfig Row6 = BB_EXTRACT_ROW_PATTERN(6);
-    value += pR2[Row6];
+    ConfigPMValue(value, potMobs, pR2, pm8, Row6);
     TConfig Row7 = BB_EXTRACT_ROW_PATTERN(7);
-    value += ValueEdgePatternsJ(pcoeffs, Row7, Row6) << 16;
-    value += pR1[Row7];
+    value += ValueEdgePatternsJ(pcoeffs, Row7, Row6);
+    potMobs += pm8[Row7];
     TConfig Row4 = BB_EXTRACT_ROW_PATTERN(4);
-    value += pR4[Row4];
+    ConfigPMValue(value, potMobs, pR4, pm8, Row4);
     TConfig Row5 = BB_EXTRACT_ROW_PATTERN(5);
-    value += pR3[Row5];
-    value += ValueTrianglePatternsJ(pcoeffs, Row7, Row6, Row5, Row4);
+    ConfigPMValue(value, potMobs, pR3, pm8, Row5);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, Row7, Row6, Row5, Row4);
 #undef BB_EXTRACT_ROW_PATTERN
     
     uint64_t flippedMover = flipDiagonal(mover);
@@ -503,106 +552,97 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
     base2ToBase3Table[(flippedMover >> (8 * (ROW))) & 0xff] * 2
     
     TConfig Column0 = BB_EXTRACT_FLIPPED_ROW_PATTERN(0);
-    value += pR1[Column0];
+    potMobs += pm8[Column0];
     TConfig Column1 = BB_EXTRACT_FLIPPED_ROW_PATTERN(1);
-    value += pR2[Column1];
-    value += ValueEdgePatternsJ(pcoeffs, Column0, Column1) << 16;
+    ConfigPMValue(value, potMobs, pR2, pm8, Column1);
+    value += ValueEdgePatternsJ(pcoeffs, Column0, Column1);
     TConfig Column6 = BB_EXTRACT_FLIPPED_ROW_PATTERN(6);
-    value += pR2[Column6];
+    ConfigPMValue(value, potMobs, pR2, pm8, Column6);
     TConfig Column7 = BB_EXTRACT_FLIPPED_ROW_PATTERN(7);
-    value += pR1[Column7];
-    value += ValueEdgePatternsJ(pcoeffs, Column7, Column6) << 16;
-    value += pR3[BB_EXTRACT_FLIPPED_ROW_PATTERN(2)];
-    value += pR3[BB_EXTRACT_FLIPPED_ROW_PATTERN(5)];
-    value += pR4[BB_EXTRACT_FLIPPED_ROW_PATTERN(3)];
-    value += pR4[BB_EXTRACT_FLIPPED_ROW_PATTERN(4)];
+    potMobs += pm8[Column7];
+    value += ValueEdgePatternsJ(pcoeffs, Column7, Column6);
+    ConfigPMValue(value, potMobs, pR3, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(2));
+    ConfigPMValue(value, potMobs, pR3, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(5));
+    ConfigPMValue(value, potMobs, pR4, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(3));
+    ConfigPMValue(value, potMobs, pR4, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(4));
 #undef BB_EXTRACT_FLIPPED_ROW_PATTERN
 
 
-    // Take apart packed information about pot mobilities
-    unsigned nPMO=(value>>8) & 0xFF;
-    unsigned nPMP=value&0xFF;
-    nPMO=(nPMO+potMobAdd)>>potMobShift;
-    nPMP=(nPMP+potMobAdd)>>potMobShift;
-    value>>=16;
-
-    // pot mobility
-    value += ConfigValue(pcoeffs, nPMP, PM1J, offsetJPMP);
-    value += ConfigValue(pcoeffs, nPMO, PM2J, offsetJPMO);
-
-    return CValue(value);
+    return ValuePotMobsJ(pcoeffs, value, potMobs);
 }
 
 #if defined(__GNUC__) && defined(__x86_64__) && !defined(__MINGW32__)
 __attribute__((target("bmi2")))
-CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+CValue CEvaluator::EvalMobsBmi2(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
     CBitBoard bb = pos2.GetBB();
-    const TCoeff *const pcoeffs = this->pcoeffs[pos2.NEmpty()];
+    const i2 *const pcoeffs = this->pcoeffs[pos2.NEmpty()];
     // This is a specialization of the Evaluator using the bmi2 pext instruction (_pext_u64)
 
-    // Value has a lower 16 bit component and a higher one. The lower bits are used to
-    // unpack potmob values (potential mobility)
+    // The pot mobs of the patterns are summed separately from the values, packed as
+    // (pot mob 1 << 8) + pot mob 2, and looked up at the end.
     TCoeff value = 0;
+    TCoeff potMobs = 0;
+    const u2* const pm8 = this->potMobs+offsetPM8;
+    const u2* const pm7 = this->potMobs+offsetPM7;
+    const u2* const pm6 = this->potMobs+offsetPM6;
+    const u2* const pm5 = this->potMobs+offsetPM5;
 
-    // mobility
-    value += (ConfigValue(pcoeffs, nMovesPlayer, M1J, offsetJMP) +
-              ConfigValue(pcoeffs, nMovesOpponent, M2J, offsetJMO) +
-    // parity
-              ConfigValue(pcoeffs, pos2.NEmpty()&1, PARJ, offsetJPAR)) << 16;
+    // mobility. The mover's mobility coefficients include the parity coefficient.
+    value += ConfigValue(pcoeffs, nMovesPlayer, M1J, offsetJMP) +
+             ConfigValue(pcoeffs, nMovesOpponent, M2J, offsetJMO);
 
     uint64_t empty = bb.empty;
     uint64_t mover = bb.mover;
 
-    const TCoeff* const pR1 = pcoeffs+offsetJR1;
-    const TCoeff* const pR2 = pcoeffs+offsetJR2;
-    const TCoeff* const pR3 = pcoeffs+offsetJR3;
-    const TCoeff* const pR4 = pcoeffs+offsetJR4;
+    const i2* const pR2 = pcoeffs+offsetJR2;
+    const i2* const pR3 = pcoeffs+offsetJR3;
+    const i2* const pR4 = pcoeffs+offsetJR4;
 
 #define BB_EXTRACT_ROW_PATTERN(ROW) \
     base2ToBase3Table[(empty >> (8 * (ROW))) & 0xff] + \
     base2ToBase3Table[(mover >> (8 * (ROW))) & 0xff] * 2
 
     TConfig Row0 = BB_EXTRACT_ROW_PATTERN(0);
-    value += pR1[Row0];
+    potMobs += pm8[Row0];     // the edge's coefficient is in its edge+2X coefficient
     TConfig Row1 = BB_EXTRACT_ROW_PATTERN(1);
-    value += pR2[Row1];
-    value += ValueEdgePatternsJ(pcoeffs, Row0, Row1) << 16;
+    ConfigPMValue(value, potMobs, pR2, pm8, Row1);
+    value += ValueEdgePatternsJ(pcoeffs, Row0, Row1);
     TConfig Row2 = BB_EXTRACT_ROW_PATTERN(2);
-    value += pR3[Row2];
+    ConfigPMValue(value, potMobs, pR3, pm8, Row2);
     TConfig Row3 = BB_EXTRACT_ROW_PATTERN(3);
-    value += pR4[Row3];
-    value += ValueTrianglePatternsJ(pcoeffs, Row0, Row1, Row2, Row3);
+    ConfigPMValue(value, potMobs, pR4, pm8, Row3);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, Row0, Row1, Row2, Row3);
 
     TConfig Row6 = BB_EXTRACT_ROW_PATTERN(6);
-    value += pR2[Row6];
+    ConfigPMValue(value, potMobs, pR2, pm8, Row6);
     TConfig Row7 = BB_EXTRACT_ROW_PATTERN(7);
-    value += pR1[Row7];
-    value += ValueEdgePatternsJ(pcoeffs, Row7, Row6) << 16;
+    potMobs += pm8[Row7];
+    value += ValueEdgePatternsJ(pcoeffs, Row7, Row6);
     TConfig Row4 = BB_EXTRACT_ROW_PATTERN(4);
-    value += pR4[Row4];
+    ConfigPMValue(value, potMobs, pR4, pm8, Row4);
     TConfig Row5 = BB_EXTRACT_ROW_PATTERN(5);
-    value += pR3[Row5];
-    value += ValueTrianglePatternsJ(pcoeffs, Row7, Row6, Row5, Row4);
+    ConfigPMValue(value, potMobs, pR3, pm8, Row5);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, Row7, Row6, Row5, Row4);
 #undef BB_EXTRACT_ROW_PATTERN
 
 #define BB_EXTRACT_STEP_PATTERN(START, COUNT, STEP) \
         (base2ToBase3Table[_pext_u64(empty, meta_repeated_bit<uint64_t, (START), (COUNT), (STEP)>::value)] + \
          2 * base2ToBase3Table[_pext_u64(mover, meta_repeated_bit<uint64_t, (START), (COUNT), (STEP)>::value)])
 
-    value += pcoeffs[offsetJD8 + BB_EXTRACT_STEP_PATTERN(0, 8, 9)];
-    value += pcoeffs[offsetJD7 + BB_EXTRACT_STEP_PATTERN(1, 7, 9)];
-    value += pcoeffs[offsetJD7 + BB_EXTRACT_STEP_PATTERN(8, 7, 9)];
-    value += pcoeffs[offsetJD6 + BB_EXTRACT_STEP_PATTERN(2, 6, 9)];
-    value += pcoeffs[offsetJD6 + BB_EXTRACT_STEP_PATTERN(16, 6, 9)];
-    value += pcoeffs[offsetJD5 + BB_EXTRACT_STEP_PATTERN(3, 5, 9)];
-    value += pcoeffs[offsetJD5 + BB_EXTRACT_STEP_PATTERN(24, 5, 9)];
-    value += pcoeffs[offsetJD8 + BB_EXTRACT_STEP_PATTERN(7, 8, 7)];
-    value += pcoeffs[offsetJD7 + BB_EXTRACT_STEP_PATTERN(6, 7, 7)];
-    value += pcoeffs[offsetJD7 + BB_EXTRACT_STEP_PATTERN(15, 7, 7)];
-    value += pcoeffs[offsetJD6 + BB_EXTRACT_STEP_PATTERN(5, 6, 7)];
-    value += pcoeffs[offsetJD6 + BB_EXTRACT_STEP_PATTERN(23, 6, 7)];
-    value += pcoeffs[offsetJD5 + BB_EXTRACT_STEP_PATTERN(4, 5, 7)];
-    value += pcoeffs[offsetJD5 + BB_EXTRACT_STEP_PATTERN(31, 5, 7)];
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD8, pm8, BB_EXTRACT_STEP_PATTERN(0, 8, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD7, pm7, BB_EXTRACT_STEP_PATTERN(1, 7, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD7, pm7, BB_EXTRACT_STEP_PATTERN(8, 7, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD6, pm6, BB_EXTRACT_STEP_PATTERN(2, 6, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD6, pm6, BB_EXTRACT_STEP_PATTERN(16, 6, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD5, pm5, BB_EXTRACT_STEP_PATTERN(3, 5, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD5, pm5, BB_EXTRACT_STEP_PATTERN(24, 5, 9));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD8, pm8, BB_EXTRACT_STEP_PATTERN(7, 8, 7));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD7, pm7, BB_EXTRACT_STEP_PATTERN(6, 7, 7));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD7, pm7, BB_EXTRACT_STEP_PATTERN(15, 7, 7));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD6, pm6, BB_EXTRACT_STEP_PATTERN(5, 6, 7));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD6, pm6, BB_EXTRACT_STEP_PATTERN(23, 6, 7));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD5, pm5, BB_EXTRACT_STEP_PATTERN(4, 5, 7));
+    ConfigPMValue(value, potMobs, pcoeffs+offsetJD5, pm5, BB_EXTRACT_STEP_PATTERN(31, 5, 7));
 #undef BB_EXTRACT_STEP_PATTERN
 
     
@@ -611,33 +651,234 @@ CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent
          2 * base2ToBase3Table[_pext_u64(mover, meta_repeated_bit<uint64_t, (ROW), 8, 8>::value)])
 
     TConfig Column0 = BB_EXTRACT_FLIPPED_ROW_PATTERN(0);
-    value += pR1[Column0];
+    potMobs += pm8[Column0];
     TConfig Column1 = BB_EXTRACT_FLIPPED_ROW_PATTERN(1);
-    value += pR2[Column1];
-    value += ValueEdgePatternsJ(pcoeffs, Column0, Column1) << 16;
+    ConfigPMValue(value, potMobs, pR2, pm8, Column1);
+    value += ValueEdgePatternsJ(pcoeffs, Column0, Column1);
     TConfig Column6 = BB_EXTRACT_FLIPPED_ROW_PATTERN(6);
-    value += pR2[Column6];
+    ConfigPMValue(value, potMobs, pR2, pm8, Column6);
     TConfig Column7 = BB_EXTRACT_FLIPPED_ROW_PATTERN(7);
-    value += pR1[Column7];
-    value += ValueEdgePatternsJ(pcoeffs, Column7, Column6) << 16;
-    value += pR3[BB_EXTRACT_FLIPPED_ROW_PATTERN(2)];
-    value += pR3[BB_EXTRACT_FLIPPED_ROW_PATTERN(5)];
-    value += pR4[BB_EXTRACT_FLIPPED_ROW_PATTERN(3)];
-    value += pR4[BB_EXTRACT_FLIPPED_ROW_PATTERN(4)];
+    potMobs += pm8[Column7];
+    value += ValueEdgePatternsJ(pcoeffs, Column7, Column6);
+    ConfigPMValue(value, potMobs, pR3, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(2));
+    ConfigPMValue(value, potMobs, pR3, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(5));
+    ConfigPMValue(value, potMobs, pR4, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(3));
+    ConfigPMValue(value, potMobs, pR4, pm8, BB_EXTRACT_FLIPPED_ROW_PATTERN(4));
 #undef BB_EXTRACT_FLIPPED_ROW_PATTERN
 
 
-    // Take apart packed information about pot mobilities
-    unsigned nPMO=(value>>8) & 0xFF;
-    unsigned nPMP=value&0xFF;
-    nPMO=(nPMO+potMobAdd)>>potMobShift;
-    nPMP=(nPMP+potMobAdd)>>potMobShift;
-    value>>=16;
+    return ValuePotMobsJ(pcoeffs, value, potMobs);
+}
 
-    // pot mobility
-    value += ConfigValue(pcoeffs, nPMP, PM1J, offsetJPMP);
-    value += ConfigValue(pcoeffs, nPMO, PM2J, offsetJPMO);
+// Base-3 configurations of eight 8-square lines, given the empty and mover bits of each line
+__attribute__((target("avx2,bmi2")))
+static inline __m256i Base3Configs(__m256i emptyBits, __m256i moverBits) {
+    const int* const table = reinterpret_cast<const int*>(base2ToBase3Table);
+    const __m256i empty3 = _mm256_i32gather_epi32(table, emptyBits, 4);
+    const __m256i mover3 = _mm256_i32gather_epi32(table, moverBits, 4);
+    return _mm256_add_epi32(empty3, _mm256_slli_epi32(mover3, 1));
+}
 
-    return CValue(value);
+// Bits of each byte of v, one byte per lane
+__attribute__((target("avx2,bmi2")))
+static inline __m256i ByteLanes(uint64_t v) {
+    return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(int64_t(v)));
+}
+
+// 16-bit table[index] for each lane selected by lanes, in the low half of the lane, and 0 in the other
+//    lanes. Each gather reads 4 bytes, so table[index+1] must also be in memory; the tables gathered
+//    from are followed by others.
+__attribute__((target("avx2,bmi2")))
+static inline __m256i GatherWords(const void* table, __m256i index, __m256i lanes) {
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(table), index, lanes, 2);
+}
+
+// Each lane's low 16 bits, sign-extended
+__attribute__((target("avx2,bmi2")))
+static inline __m256i SignExtendWords(__m256i v) {
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+// Sum of the lanes of v
+__attribute__((target("avx2,bmi2")))
+static inline int HorizontalSum(__m256i v) {
+    __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum4);
+}
+
+__attribute__((target("avx2,bmi2")))
+CValue CEvaluator::EvalMobsAvx2(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+    CBitBoard bb = pos2.GetBB();
+    const i2 *const pcoeffs = this->pcoeffs[pos2.NEmpty()];
+    // This is a specialization of the bmi2 Evaluator that does the line patterns eight at a time:
+    // the base-3 conversions and the coefficient lookups for rows, columns and diagonals are
+    // vpgatherdd gathers, and the coefficients and pot mobs are summed in vector registers. They
+    // are only ever added, so the sums are the same as the scalar evaluators'.
+
+    // The pot mobs of the patterns are summed separately from the values, packed as
+    // (pot mob 1 << 8) + pot mob 2, and looked up at the end.
+    TCoeff value = 0;
+    TCoeff potMobs = 0;
+
+    // mobility. The mover's mobility coefficients include the parity coefficient.
+    value += ConfigValue(pcoeffs, nMovesPlayer, M1J, offsetJMP) +
+             ConfigValue(pcoeffs, nMovesOpponent, M2J, offsetJMO);
+
+    uint64_t empty = bb.empty;
+    uint64_t mover = bb.mover;
+    uint64_t flippedEmpty = flipDiagonal(empty);
+    uint64_t flippedMover = flipDiagonal(mover);
+
+    // rows and columns use the same coefficients: 2nd, 3rd and 4th lines from each side. The edges'
+    // coefficients are in their edge+2X coefficients, so only their pot mobs are gathered.
+    const __m256i lineOffsets = _mm256_setr_epi32(0, offsetJR2, offsetJR3, offsetJR4,
+                                                  offsetJR4, offsetJR3, offsetJR2, 0);
+    const __m256i innerLines = _mm256_setr_epi32(0, -1, -1, -1, -1, -1, -1, 0);
+    const __m256i allLanes = _mm256_set1_epi32(-1);
+    const __m256i rows = Base3Configs(ByteLanes(empty), ByteLanes(mover));
+    const __m256i columns = Base3Configs(ByteLanes(flippedEmpty), ByteLanes(flippedMover));
+    // each coefficient is sign-extended from its lane's low 16 bits before it is summed
+    __m256i sum = SignExtendWords(GatherWords(pcoeffs, _mm256_add_epi32(rows, lineOffsets), innerLines));
+    sum = _mm256_add_epi32(sum, SignExtendWords(GatherWords(pcoeffs, _mm256_add_epi32(columns, lineOffsets), innerLines)));
+    __m256i potMobSum = _mm256_add_epi32(GatherWords(this->potMobs+offsetPM8, rows, allLanes),
+                                         GatherWords(this->potMobs+offsetPM8, columns, allLanes));
+
+#define BB_EXTRACT_STEP_BITS(BB, START, COUNT, STEP) \
+        int(_pext_u64((BB), meta_repeated_bit<uint64_t, (START), (COUNT), (STEP)>::value))
+#define BB_STEP_BITS(BB) \
+        _mm256_setr_epi32(BB_EXTRACT_STEP_BITS(BB, 0, 8, 9), BB_EXTRACT_STEP_BITS(BB, 7, 8, 7), \
+                          BB_EXTRACT_STEP_BITS(BB, 1, 7, 9), BB_EXTRACT_STEP_BITS(BB, 8, 7, 9), \
+                          BB_EXTRACT_STEP_BITS(BB, 6, 7, 7), BB_EXTRACT_STEP_BITS(BB, 15, 7, 7), \
+                          BB_EXTRACT_STEP_BITS(BB, 2, 6, 9), BB_EXTRACT_STEP_BITS(BB, 16, 6, 9))
+#define BB_SHORT_STEP_BITS(BB) \
+        _mm256_setr_epi32(BB_EXTRACT_STEP_BITS(BB, 5, 6, 7), BB_EXTRACT_STEP_BITS(BB, 23, 6, 7), \
+                          BB_EXTRACT_STEP_BITS(BB, 3, 5, 9), BB_EXTRACT_STEP_BITS(BB, 24, 5, 9), \
+                          BB_EXTRACT_STEP_BITS(BB, 4, 5, 7), BB_EXTRACT_STEP_BITS(BB, 31, 5, 7), 0, 0)
+
+    // diagonals: the 8s, 7s and two of the 6s, then the other 6s and the 5s in six of eight lanes
+    const __m256i diagonalOffsets = _mm256_setr_epi32(offsetJD8, offsetJD8, offsetJD7, offsetJD7,
+                                                      offsetJD7, offsetJD7, offsetJD6, offsetJD6);
+    const __m256i shortDiagonalOffsets = _mm256_setr_epi32(offsetJD6, offsetJD6, offsetJD5, offsetJD5,
+                                                           offsetJD5, offsetJD5, 0, 0);
+    const __m256i diagonalPotMobOffsets = _mm256_setr_epi32(offsetPM8, offsetPM8, offsetPM7, offsetPM7,
+                                                            offsetPM7, offsetPM7, offsetPM6, offsetPM6);
+    const __m256i shortDiagonalPotMobOffsets = _mm256_setr_epi32(offsetPM6, offsetPM6, offsetPM5, offsetPM5,
+                                                                 offsetPM5, offsetPM5, 0, 0);
+    const __m256i shortDiagonalLanes = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+    const __m256i diagonals = Base3Configs(BB_STEP_BITS(empty), BB_STEP_BITS(mover));
+    const __m256i shortDiagonals = Base3Configs(BB_SHORT_STEP_BITS(empty), BB_SHORT_STEP_BITS(mover));
+    sum = _mm256_add_epi32(sum, SignExtendWords(GatherWords(pcoeffs,
+            _mm256_add_epi32(diagonals, diagonalOffsets), allLanes)));
+    sum = _mm256_add_epi32(sum, SignExtendWords(GatherWords(pcoeffs,
+            _mm256_add_epi32(shortDiagonals, shortDiagonalOffsets), shortDiagonalLanes)));
+    potMobSum = _mm256_add_epi32(potMobSum, GatherWords(this->potMobs,
+            _mm256_add_epi32(diagonals, diagonalPotMobOffsets), allLanes));
+    potMobSum = _mm256_add_epi32(potMobSum, GatherWords(this->potMobs,
+            _mm256_add_epi32(shortDiagonals, shortDiagonalPotMobOffsets), shortDiagonalLanes));
+#undef BB_SHORT_STEP_BITS
+#undef BB_STEP_BITS
+#undef BB_EXTRACT_STEP_BITS
+
+    // the corner patterns are built from the row and column configurations
+    alignas(32) uint32_t rowConfigs[8];
+    alignas(32) uint32_t columnConfigs[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(rowConfigs), rows);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(columnConfigs), columns);
+
+    value += ValueEdgePatternsJ(pcoeffs, rowConfigs[0], rowConfigs[1]);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, rowConfigs[0], rowConfigs[1], rowConfigs[2], rowConfigs[3]);
+    value += ValueEdgePatternsJ(pcoeffs, rowConfigs[7], rowConfigs[6]);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, rowConfigs[7], rowConfigs[6], rowConfigs[5], rowConfigs[4]);
+    value += ValueEdgePatternsJ(pcoeffs, columnConfigs[0], columnConfigs[1]);
+    value += ValueEdgePatternsJ(pcoeffs, columnConfigs[7], columnConfigs[6]);
+
+    // horizontal sums of the line patterns; the pot mobs are the low 16 bits of each lane
+    value += HorizontalSum(sum);
+    potMobs += HorizontalSum(_mm256_and_si256(potMobSum, _mm256_set1_epi32(0xFFFF)));
+
+    return ValuePotMobsJ(pcoeffs, value, potMobs);
+}
+
+// EvalMobs() is resolved once, at load time, to the fastest implementation the processor supports.
+__attribute__((target("default")))
+CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+    return EvalMobsScalar(pos2, nMovesPlayer, nMovesOpponent);
+}
+
+__attribute__((target("bmi2")))
+CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+    return EvalMobsBmi2(pos2, nMovesPlayer, nMovesOpponent);
+}
+
+__attribute__((target("avx2,bmi2")))
+CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+    return EvalMobsAvx2(pos2, nMovesPlayer, nMovesOpponent);
+}
+#else
+CValue CEvaluator::EvalMobs(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+    return EvalMobsScalar(pos2, nMovesPlayer, nMovesOpponent);
 }
 #endif
+
+#if POS2_TRACK_PATTERNS
+// Coefficient offsets of Pos2's line patterns: rows and columns from the edge in, then the diagonals.
+//    Edges are -1; their coefficients are in their edge+2X coefficients.
+static const int linePatternOffsets[Pos2::nLinePatterns] = {
+    -1, offsetJR2, offsetJR3, offsetJR4, offsetJR4, offsetJR3, offsetJR2, -1,
+    -1, offsetJR2, offsetJR3, offsetJR4, offsetJR4, offsetJR3, offsetJR2, -1,
+    offsetJD8, offsetJD7, offsetJD7, offsetJD6, offsetJD6, offsetJD5, offsetJD5,
+    offsetJD8, offsetJD7, offsetJD7, offsetJD6, offsetJD6, offsetJD5, offsetJD5,
+};
+
+// Pot mob offsets of Pos2's line patterns, by line length
+static const int linePatternPotMobOffsets[Pos2::nLinePatterns] = {
+    offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8,
+    offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8, offsetPM8,
+    offsetPM8, offsetPM7, offsetPM7, offsetPM6, offsetPM6, offsetPM5, offsetPM5,
+    offsetPM8, offsetPM7, offsetPM7, offsetPM6, offsetPM6, offsetPM5, offsetPM5,
+};
+
+CValue CEvaluator::EvalPatterns(const Pos2& pos2, u4 nMovesPlayer, u4 nMovesOpponent) const {
+    assert(pos2.m_fPatterns);
+    const i2 *const pcoeffs = this->pcoeffs[pos2.NEmpty()];
+    const u2* const configs = pos2.m_patterns;
+    // The line patterns are extracted from the board as MakeMoveBB() goes, so all that is left
+    // is to look them up. The corner patterns are built from the rows and columns as in EvalMobs().
+
+    // The pot mobs of the patterns are summed separately from the values, packed as
+    // (pot mob 1 << 8) + pot mob 2, and looked up at the end.
+    TCoeff value = 0;
+    TCoeff potMobs = 0;
+
+    // mobility. The mover's mobility coefficients include the parity coefficient.
+    value += ConfigValue(pcoeffs, nMovesPlayer, M1J, offsetJMP) +
+             ConfigValue(pcoeffs, nMovesOpponent, M2J, offsetJMO);
+
+    for (int pattern=0; pattern<Pos2::nLinePatterns; pattern++) {
+        const TConfig config=configs[pattern];
+        if (linePatternOffsets[pattern]>=0)
+            value += pcoeffs[linePatternOffsets[pattern]+config];
+        potMobs += this->potMobs[linePatternPotMobOffsets[pattern]+config];
+    }
+
+    const u2* const rows = configs;
+    const u2* const columns = configs + 8;
+    value += ValueEdgePatternsJ(pcoeffs, rows[0], rows[1]);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, rows[0], rows[1], rows[2], rows[3]);
+    value += ValueEdgePatternsJ(pcoeffs, rows[7], rows[6]);
+    ValueTrianglePatternsJ(value, potMobs, pcoeffs, this->potMobs, rows[7], rows[6], rows[5], rows[4]);
+    value += ValueEdgePatternsJ(pcoeffs, columns[0], columns[1]);
+    value += ValueEdgePatternsJ(pcoeffs, columns[7], columns[6]);
+
+    return ValuePotMobsJ(pcoeffs, value, potMobs);
+}
+#endif
+
+// Evaluations of different positions don't depend on each other, so with the calls back to back
+// the processor starts on the next position's table lookups while the last ones are outstanding.
+void CEvaluator::EvalMobsBatch(const Pos2 positions[], const u4 nMovesPlayer[], const u4 nMovesOpponent[], int n, CValue values[]) const {
+    for (int i=0; i<n; i++)
+        values[i]=Eval(positions[i], nMovesPlayer[i], nMovesOpponent[i]);
+}
@@ -49,9 +49,35 @@ public:
     CValue EvalMobs(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
     __attribute__((target("bmi2")))
     CValue EvalMobs(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
+    __attribute__((target("avx2,bmi2")))
+    CValue EvalMobs(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
 #else
     CValue EvalMobs(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
 #endif
+    //! The implementations of EvalMobs(), which calls the fastest one the processor supports.
+    //!    They give the same values; they are public so that the tests can check that.
+    CValue EvalMobsScalar(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__MINGW32__)
+    __attribute__((target("bmi2")))
+    CValue EvalMobsBmi2(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
+    __attribute__((target("avx2,bmi2")))
+    CValue EvalMobsAvx2(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
+#endif
+#if POS2_TRACK_PATTERNS
+    //! EvalMobs() using the pattern configurations tracked by pos (see Pos2::fTrackPatterns)
+    CValue EvalPatterns(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const;
+    //! EvalPatterns() if pos tracks its patterns, otherwise EvalMobs()
+    CValue Eval(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const {
+        return pos.m_fPatterns ? EvalPatterns(pos, nMovesPlayer, nMovesOpponent) : EvalMobs(pos, nMovesPlayer, nMovesOpponent);
+    }
+#else
+    //! EvalMobs(); this build doesn't track patterns
+    CValue Eval(const Pos2& pos, u4 nMovesPlayer, u4 nMovesOpponent) const {
+        return EvalMobs(pos, nMovesPlayer, nMovesOpponent);
+    }
+#endif
+    //! Evaluate n positions: values[i]=Eval(positions[i], nMovesPlayer[i], nMovesOpponent[i])
+    void EvalMobsBatch(const Pos2 positions[], const u4 nMovesPlayer[], const u4 nMovesOpponent[], int n, CValue values[]) const;
 
     ~CEvaluator();
 
@@ -60,9 +86,12 @@ protected:
 
 private:
     CEvaluator(const std::string& fnBase, int nFiles);
-    TCoeff *coeffs[60];
-    TCoeff *pcoeffs[60];
+    i2 *coeffs[60];
+    i2 *pcoeffs[60];
     int nSets;
+    i2 *coeffBlock;         //!< memory for all coeffs[] arrays
+    size_t coeffBlockSize;
+    u2 *potMobs;            //!< packed pot mobs of each line and triangle configuration, shared by all coeffs[] sets
 };
 
 extern int coeffStartsJ[nMapsJ];
@@ -13,6 +13,7 @@
 #include "Pos2.h"
 #include "SearchParams.h"
 #include "Search.h"
+#include "SearchThreads.h"
 #include "Evaluator.h"
 
 #include "PlayerComputer.h"
@@ -30,6 +31,7 @@ CComputerDefaults::CComputerDefaults() : sCalcParams("s12"), cEval('J'), cCoeffS
 	nRandShifts[0]=nRandShifts[1]=0;
 	fsPrint=5;
 	fsPrintOpponent=1;
+	nThreads=1;
 }
 
 int CComputerDefaults::MinutesOrDepth() const {
@@ -58,8 +60,7 @@ CPlayerComputer::CPlayerComputer(const CComputerDefaults& acd) {
 	cd=acd;
 	pcp=CCalcParams::NewFromString(cd.sCalcParams);
 
-	caches[0]=caches[1]=NULL;
-	fHasCachedPos[0]=fHasCachedPos[1]=false;
+	cache=NULL;
 	eval=CEvaluator::FindEvaluator(cd.cEval, cd.cCoeffSet);
 	mpcs=CMPCStats::GetMPCStats(cd.cEval, cd.cCoeffSet, std::max(cd.iPruneMidgame, cd.iPruneEndgame));
 	fAnalyzingDeferred=false;
@@ -80,41 +81,17 @@ CPlayerComputer::CPlayerComputer(const CComputerDefaults& acd) {
 }
 
 CPlayerComputer::~CPlayerComputer() {
-	int i;
-	for (i=0; i<2; i++)
-		if (caches[i])
-			delete caches[i];
+	if (cache && !fnCacheSnapshot.empty() && !cache->Save(fnCacheSnapshot.c_str()))
+		std::cerr << "unable to save cache snapshot " << fnCacheSnapshot << "\n";
+	delete cache;
 
 	delete mpcs;
 	delete pcp;
 }
 
-u4 CPlayerComputer::LogCacheSize(CCalcParams* pcp, int aPrune) {
-  return 21;
-  /*
-	u2 lgCacheSize;
-	
-	// basic suggestion from the calc params
-	lgCacheSize=pcp->LogCacheSize(aPrune);
-
-	// constrain lgCacheSize to be reasonable, due in part to Pentium handling of
-	//	shift operators with right operand >= 32
-	if (lgCacheSize<2)
-		lgCacheSize=2;
-	else if (lgCacheSize>30)
-		lgCacheSize=30;
-
-	// constrain lgCacheSize to fit within available RAM (from params.txt)
-	if (maxCacheMem>sizeof(CCacheData)) {
-		while (sizeof(CCacheData) > maxCacheMem>>lgCacheSize)
-			lgCacheSize--;
-	}
-
-	// lgCacheSize must be at least 2, due to the way cache operates
-	if (lgCacheSize<2)
-		lgCacheSize=2;
-
-	return lgCacheSize; */
+//! Number of cache entries that fit in maxCacheMem
+u64 CPlayerComputer::CacheEntries() {
+	return u64(CCache::NBucketsFor(maxCacheMem/sizeof(CCacheEntry)))*CCacheBucket::nWays;
 }
 
 //! Set the contempt such that draws always go to black or white, depending on fDrawsToBlack
@@ -126,17 +103,33 @@ void CPlayerComputer::SetContempt(bool fDrawsToBlack) {
 	cd.vContempts[0]=vContempt; cd.vContempts[1]=-vContempt;
 }
 
+//! Get the cache, creating it if needed, and set it up for searches in game iCache.
+//! The cache is loaded from fnCacheSnapshot if that is set.
+//! If the cache size doesn't match maxCacheMem, resize it. The near tier is set from nearCacheMem and hNearCache.
 CCache* CPlayerComputer::GetCache(int iCache) {
-	if (caches[iCache]==NULL)
-		caches[iCache]=new CCache(1<<LogCacheSize(pcp, cd.iPruneMidgame && cd.iPruneEndgame));
+	const u64 nEntries=CacheEntries();
+	if (cache==NULL && !fnCacheSnapshot.empty()) {
+		try {
+			cache=new CCache(fnCacheSnapshot.c_str());
+		}
+		catch(const std::string& message) {
+			std::cerr << message << "\n";
+		}
+	}
+	if (cache==NULL)
+		cache=new CCache(nEntries);
+	else if (cache->NEntries()!=nEntries)
+		cache->Resize(nEntries);
 
-	if (caches[iCache]==NULL) {
-		std::cerr << "out of memory allocating cache " << iCache << " for computer " << Name() << "\n";
+	if (cache==NULL) {
+		std::cerr << "out of memory allocating cache for computer " << Name() << "\n";
 		assert(0);
 		exit(-1);
 	}
+	cache->SetNearTier(nearCacheMem/sizeof(CCacheEntry), hNearCache);
+	cache->SetGame(iCache);
 
-	return caches[iCache];
+	return cache;
 }
 
 //! Get my move (if it's my move) or my recommended move (if it's the opponent move) and the time taken
@@ -246,10 +239,12 @@ void CPlayerComputer::GetChosen(const CSearchInfo& si, const CQPosition& pos, CM
 }
 
 void CPlayerComputer::Clear() {
-	int i;
-	for (i=0; i<2; i++)
-		if (caches[i])
-			caches[i]->SetStale();
+	if (cache) {
+		for (int i=0; i<CCache::nGames; i++) {
+			cache->SetGame(i);
+			cache->SetStale();
+		}
+	}
 	solved=false;
 }
 
@@ -276,23 +271,12 @@ void CPlayerComputer::EndGame(const COsGame& game) {
 }
 
 
-static void prepareCache() {
-	tSetStale=::cache->NBuckets()*1E-7/dGHz;
-}
-
 void CPlayerComputer::SetParameters(const CQPosition& pos, int iCache) {
 	// Set up parameters
+	// both games share the cache, so this game finds the other game's entries without copying them
 	::cache=GetCache(iCache);
 
-	// we may want to copy the other cache, if the position is a predecessor
-	posCached[iCache]=pos;
-	fHasCachedPos[iCache]=true;
-	if (caches[!iCache] && fHasCachedPos[!iCache] && posCached[!iCache].IsSuccessor(pos)) {
-		caches[iCache]->CopyData(*(caches[!iCache]));
-		cout << "Cache copy!\n";
-	}
-
-	prepareCache();
+	SetSearchThreads(cd.nThreads);
 	//::iPruneMidgame = iPruneMidgame;
 	//::iPruneEndgame = iPruneEndgame;
 	::mpcs = mpcs;
@@ -303,7 +287,7 @@ void CPlayerComputer::SetParameters(int iCache) {
 	// Set up parameters
 	::cache=GetCache(iCache);
 
-	prepareCache();
+	SetSearchThreads(cd.nThreads);
 	//::iPruneMidgame = iPruneMidgame;
 	//::iPruneEndgame = iPruneEndgame;
 	::mpcs = mpcs;
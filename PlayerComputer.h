@@ -22,6 +22,7 @@ public:
 	int iPruneEndgame, iPruneMidgame, nRandShifts[2];
 	u4 iEdmund;
 	u4 fsPrint, fsPrintOpponent;
+	int nThreads;	//!< number of search threads
 
 	int MinutesOrDepth() const;
 
@@ -32,8 +33,7 @@ public:
 class CPlayerComputer : public CPlayer {
 public:
 	CEvaluator* eval;
-	CCache *caches[2];
-	bool fHasCachedPos[2];
+	CCache *cache;	//!< shared by both games of a synchro match
 	CCalcParams *pcp;
 	CMPCStats *mpcs;
 	CComputerDefaults cd;
@@ -61,7 +61,7 @@ public:
 
 
 	// misc
-	static u4 LogCacheSize(CCalcParams* pcp, int iPrune);
+	static u64 CacheEntries();
 	int AdjustedHeight(const CQPosition& pos) const;
 	void SetContempt(bool fDrawsToBlack);
 
@@ -73,5 +73,4 @@ protected:
 	void SetParameters(int iCache);
 	static int DefaultRandomness();
 	virtual CCache* GetCache(int iCache);
-	CQPosition posCached[2];
 };
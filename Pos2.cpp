@@ -10,6 +10,7 @@
 #include <fstream>
 #include <math.h>
 #include "n64/flips.h"
+#include "n64/bitextractor.h"
 #include "port.h"
 #include "n64/test.h"
 #include "n64/utils.h"
@@ -41,6 +42,18 @@ void Pos2::InitializeToStartPosition() {
 void Pos2::Initialize(const char* sBoard, bool fBlackMove) {
     m_fBlackMove=fBlackMove;
     m_bb.Initialize(sBoard, m_fBlackMove);
+
+    m_stable=0;
+    m_stable_mover=m_stable_opponent=0;
+    m_stable_trigger=0;
+    if (fTrackStable)
+        CalcStable();
+
+#if POS2_TRACK_PATTERNS
+    m_fPatterns=fTrackPatterns;
+    if (m_fPatterns)
+        CalcPatterns();
+#endif
 }
 
 void Pos2::Initialize(const CBitBoard& m_bb, bool m_fBlackMove) {
@@ -55,32 +68,115 @@ void Pos2::Initialize(const CBitBoard& m_bb, bool m_fBlackMove) {
 // Move routines
 ///////////////////////////////////////////////////////////////////////////////
 
+bool Pos2::fTrackStable=false;
+
+// Update m_stable, m_stable_trigger and the stable disc counts for the current board.
+//    Discs already in m_stable stay stable.
+void Pos2::CalcStable() {
+    const u64 opponent = ~(m_bb.mover | m_bb.empty);
+
+    // stable_discs() can also mark empty squares on the edges
+    m_stable = stable_discs(m_bb.mover, opponent, m_bb.empty, m_stable) & ~m_bb.empty;
+    m_stable_trigger = stable_next_mask(m_stable, ~m_bb.empty);
+
+    m_stable_mover = bitCountInt(m_stable & m_bb.mover);
+    m_stable_opponent = bitCountInt(m_stable & opponent);
+}
+
+#if POS2_TRACK_PATTERNS
+bool Pos2::fTrackPatterns=false;
+
+#define DIAGONAL(START, COUNT, STEP) meta_repeated_bit<u64, (START), (COUNT), (STEP)>::value
+#define COLUMN(COL) meta_repeated_bit<u64, (COL), 8, 8>::value
+const u64 Pos2::linePatternMasks[nLinePatterns] = {
+    0xFFULL, 0xFFULL<<8, 0xFFULL<<16, 0xFFULL<<24, 0xFFULL<<32, 0xFFULL<<40, 0xFFULL<<48, 0xFFULL<<56,
+    COLUMN(0), COLUMN(1), COLUMN(2), COLUMN(3), COLUMN(4), COLUMN(5), COLUMN(6), COLUMN(7),
+    DIAGONAL(0, 8, 9), DIAGONAL(1, 7, 9), DIAGONAL(8, 7, 9), DIAGONAL(2, 6, 9), DIAGONAL(16, 6, 9), DIAGONAL(3, 5, 9), DIAGONAL(24, 5, 9),
+    DIAGONAL(7, 8, 7), DIAGONAL(6, 7, 7), DIAGONAL(15, 7, 7), DIAGONAL(5, 6, 7), DIAGONAL(23, 6, 7), DIAGONAL(4, 5, 7), DIAGONAL(31, 5, 7),
+};
+#undef COLUMN
+#undef DIAGONAL
+
+// 3^8-1 for rows and columns, 3^n-1 for diagonals of length n. The unused slots stay 0.
+const u2 Pos2::moverPatterns[nPatternSlots] = {
+    6560, 6560, 6560, 6560, 6560, 6560, 6560, 6560,
+    6560, 6560, 6560, 6560, 6560, 6560, 6560, 6560,
+    6560, 2186, 2186, 728, 728, 242, 242,
+    6560, 2186, 2186, 728, 728, 242, 242,
+};
+
+// For each square, the patterns it is in and its weight in each: every square is in a row, a column
+//    and up to two diagonals. Squares with no second diagonal point at an unused slot with weight 0.
+struct PatternSquares {
+    struct Entry {
+        u1 pattern;
+        u2 weight;
+    };
+    Entry entries[64][4];
+
+    PatternSquares() {
+        int nEntries[64]={0};
+        for (int pattern=0; pattern<Pos2::nLinePatterns; pattern++) {
+            u2 weight=1;
+            for (u64 bits=Pos2::linePatternMasks[pattern]; bits; bits&=bits-1) {
+                const int sq=lowBitIndex(bits);
+                entries[sq][nEntries[sq]++]={u1(pattern), weight};
+                weight*=3;
+            }
+        }
+        for (int sq=0; sq<64; sq++) {
+            while (nEntries[sq]<4)
+                entries[sq][nEntries[sq]++]={u1(Pos2::nLinePatterns), 0};
+        }
+    }
+};
+static const PatternSquares patternSquares;
+
+// Calculate m_patterns from the board
+void Pos2::CalcPatterns() {
+    for (int pattern=0; pattern<nPatternSlots; pattern++)
+        m_patterns[pattern]=0;
+    for (int sq=0; sq<64; sq++) {
+        const int digit=(m_bb.empty&mask(sq)) ? 1 : (m_bb.mover&mask(sq)) ? 2 : 0;
+        for (const PatternSquares::Entry& entry : patternSquares.entries[sq])
+            m_patterns[entry.pattern]+=u2(digit*entry.weight);
+    }
+}
+#endif
+
 void Pos2::MakeMoveBB(int square) {
     u64 flip = flips(square, m_bb.mover, ~(m_bb.mover | m_bb.empty)) | mask(square);
     assert ((m_stable & flip) == 0);
     m_bb.empty ^= mask(square);
     m_bb.mover ^= flip;
 
-    /*
+    // only the move square can be a trigger square, since the flipped discs aren't empty
     if (flip & m_stable_trigger) {
-      auto opponent = ~(m_bb.mover | m_bb.empty);
-      
-      m_stable = stable_discs(m_bb.mover, opponent, m_bb.empty, m_stable);
-      m_stable_trigger = stable_next_mask(m_stable, ~m_bb.empty);
-      
-      m_stable_mover = bitCount(m_stable & m_bb.mover);
-      m_stable_opponent = bitCount(m_stable & opponent);
-    } */
+        CalcStable();
+    }
     if (m_stable) {
         auto stable_swap = m_stable_mover;
         m_stable_mover = m_stable_opponent;
         m_stable_opponent = stable_swap;
     }
 
+#if POS2_TRACK_PATTERNS
+    if (m_fPatterns) {
+        // the move square goes from empty (1) to mover (2) and the flipped discs from opponent (0) to mover
+        for (const PatternSquares::Entry& entry : patternSquares.entries[square])
+            m_patterns[entry.pattern]+=entry.weight;
+        for (u64 flipped=flip^mask(square); flipped; flipped&=flipped-1) {
+            for (const PatternSquares::Entry& entry : patternSquares.entries[lowBitIndex(flipped)])
+                m_patterns[entry.pattern]+=u2(2*entry.weight);
+        }
+        InvertPatterns();
+    }
+#endif
+
     m_bb.InvertColors();
  
     m_fBlackMove=!m_fBlackMove;
-    nBBFlips++;
+    nBBFlipsQuick++;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -13,6 +13,13 @@
 #include "pattern/patternJ.h"
 #include "Stable.hpp"
 
+// If nonzero, Pos2 can track its line pattern configurations (see Pos2::fTrackPatterns).
+// They add 64 bytes to every Pos2, which every position copy in the search pays for even with
+// tracking off, so they are only built in on request.
+#ifndef POS2_TRACK_PATTERNS
+#define POS2_TRACK_PATTERNS 0
+#endif
+
 // global variables
 
 class Pos2 {
@@ -60,23 +67,62 @@ public:
         return m_bb.CalcMobility(nMovesPlayer,nMovesOpponent);
     }
 
+    // Stable discs, found incrementally by MakeMoveBB() when fTrackStable is set.
+    //    They are recalculated when a move is played on a trigger square: an empty corner or
+    //    an empty square next to a stable disc. Discs made stable in other ways (for instance
+    //    by filling a line) are found at the next recalculation.
+    static bool fTrackStable;
     uint64_t m_stable = 0;
-    uint64_t m_stable_trigger = Corners;
+    uint64_t m_stable_trigger = 0;
     CBitBoard m_bb;
     uint8_t m_stable_mover = 0;
     uint8_t m_stable_opponent = 0;
     bool m_fBlackMove;
+
+#if POS2_TRACK_PATTERNS
+    // Base-3 configurations of the line patterns, kept up to date by MakeMoveBB() when
+    //    fTrackPatterns is set so the evaluator doesn't have to extract them from the board.
+    //    The patterns are the rows, then the columns, then the diagonals of 5 or more squares
+    //    (see linePatternMasks). As in the evaluator, a square is 0 for an opponent disc, 1 if
+    //    empty and 2 for a mover disc, and the nth square of the pattern has weight 3^n.
+    //    m_patterns is only valid if m_fPatterns is set; it is set by Initialize().
+    enum { nLinePatterns = 30, nPatternSlots = 32 };
+    static bool fTrackPatterns;
+    static const u64 linePatternMasks[nLinePatterns];
+    bool m_fPatterns = false;
+    alignas(16) u2 m_patterns[nPatternSlots];
+#endif
 private:
     int CalcMovesAndPassBB(CMoves& moves, const CMoves& submoves);
+    void CalcStable();
+#if POS2_TRACK_PATTERNS
+    void CalcPatterns();
+    void InvertPatterns();
+
+    static const u2 moverPatterns[nPatternSlots];   //!< configuration of each pattern with a mover disc on every square
+#endif
 };
 
 inline int Pos2::TerminalValue() const {
     return m_bb.TerminalValue();
 }
 
+#if POS2_TRACK_PATTERNS
+// The other player's view of the patterns: mover and opponent discs swap, so each
+//    square's digit d becomes 2-d.
+inline void Pos2::InvertPatterns() {
+    for (int i=0; i<nPatternSlots; i++)
+        m_patterns[i]=u2(moverPatterns[i]-m_patterns[i]);
+}
+#endif
+
 inline void Pos2::PassBase() {
     m_fBlackMove=!m_fBlackMove;
     m_bb.mover = ~(m_bb.mover | m_bb.empty);
+#if POS2_TRACK_PATTERNS
+    if (m_fPatterns)
+        InvertPatterns();
+#endif
     if (m_stable) {
         auto stable_swap = m_stable_mover;
         m_stable_mover = m_stable_opponent;
@@ -87,6 +133,10 @@ inline void Pos2::PassBase() {
 inline void Pos2::PassBB() {
     m_fBlackMove = !m_fBlackMove;
     m_bb.InvertColors();
+#if POS2_TRACK_PATTERNS
+    if (m_fPatterns)
+        InvertPatterns();
+#endif
     if (m_stable) {
         auto stable_swap = m_stable_mover;
         m_stable_mover = m_stable_opponent;
@@ -7,6 +7,7 @@
 
 #include "SearchParams.h"
 #include "Pos2.h"
+#include "Evaluator.h"
 #include "SpeedTest.h"
 
 using namespace std;
@@ -114,9 +115,97 @@ static void TestMakeMove() {
     }
 }
 
+//! Stable discs found while playing through the test games are stable, keep their colour, and are counted correctly
+static void TestTrackStable() {
+    const bool fTrackStableSave=Pos2::fTrackStable;
+    Pos2::fTrackStable=true;
+
+    const std::vector<COsGame> sgTest = LoadTestGames();
+    bool fFoundStable=false;
+    for (size_t iGame=0; iGame<sgTest.size() && iGame<100; iGame++) {
+        const COsGame& sg=sgTest[iGame];
+        Pos2 pos2;
+        pos2.Initialize(CQPosition(sg.GetPosStart().board).BitBoard(), sg.GetPosStart().board.IsBlackMove());
+        u64 blackStable=0;
+        for (size_t iMove=0; iMove<sg.ml.size(); iMove++) {
+            const CMove move=sg.ml[iMove].mv;
+            if (move.IsPass())
+                pos2.PassBB();
+            else
+                pos2.MakeMoveBB(move.Square());
+
+            const CBitBoard& bb=pos2.GetBB();
+            const u64 opponent=~(bb.mover|bb.empty);
+            assertEquals(0, pos2.m_stable&bb.empty);
+            assertEquals(0, pos2.m_stable&~stable_discs(bb.mover, opponent, bb.empty));
+            assertEquals(bitCountInt(pos2.m_stable&bb.mover), pos2.m_stable_mover);
+            assertEquals(bitCountInt(pos2.m_stable&opponent), pos2.m_stable_opponent);
+
+            // a black stable disc stays black
+            const u64 black=pos2.BlackMove() ? bb.mover : opponent;
+            assertEquals(blackStable, blackStable&black);
+            blackStable=pos2.m_stable&black;
+            fFoundStable|=pos2.m_stable!=0;
+        }
+    }
+    assertTrue(fFoundStable);
+
+    Pos2::fTrackStable=fTrackStableSave;
+}
+
+#if POS2_TRACK_PATTERNS
+//! Pattern configurations updated while playing through the test games match the ones calculated from
+//! the board, and evaluating from them gives the same values as EvalMobs()
+static void TestTrackPatterns() {
+    const bool fTrackPatternsSave=Pos2::fTrackPatterns;
+    const CEvaluator* const eval=CEvaluator::FindEvaluator('J','A');
+
+    const std::vector<COsGame> sgTest = LoadTestGames();
+    for (size_t iGame=0; iGame<sgTest.size() && iGame<100; iGame++) {
+        const COsGame& sg=sgTest[iGame];
+        Pos2::fTrackPatterns=true;
+        Pos2 pos2;
+        pos2.Initialize(CQPosition(sg.GetPosStart().board).BitBoard(), sg.GetPosStart().board.IsBlackMove());
+        for (size_t iMove=0; iMove<sg.ml.size(); iMove++) {
+            const CMove move=sg.ml[iMove].mv;
+            if (move.IsPass())
+                pos2.PassBB();
+            else
+                pos2.MakeMoveBB(move.Square());
+
+            Pos2 fresh;
+            fresh.Initialize(pos2.GetBB(), pos2.BlackMove());
+            assertTrue(pos2.m_fPatterns);
+            for (int pattern=0; pattern<Pos2::nPatternSlots; pattern++)
+                assertEquals(fresh.m_patterns[pattern], pos2.m_patterns[pattern]);
+
+            if (pos2.NEmpty()) {
+                u4 nMovesPlayer, nMovesOpponent;
+                pos2.CalcMobility(nMovesPlayer, nMovesOpponent);
+                assertEquals(eval->EvalMobs(pos2, nMovesPlayer, nMovesOpponent), eval->EvalPatterns(pos2, nMovesPlayer, nMovesOpponent));
+                pos2.PassBase();
+                assertEquals(eval->EvalMobs(pos2, nMovesOpponent, nMovesPlayer), eval->EvalPatterns(pos2, nMovesOpponent, nMovesPlayer));
+                pos2.PassBase();
+            }
+        }
+
+        // positions set up without tracking are evaluated from the board
+        Pos2::fTrackPatterns=false;
+        Pos2 untracked;
+        untracked.Initialize(pos2.GetBB(), pos2.BlackMove());
+        assertFalse(untracked.m_fPatterns);
+    }
+
+    Pos2::fTrackPatterns=fTrackPatternsSave;
+}
+#endif
 
 void TestPos2() {
     TestMakeMove();
+    TestTrackStable();
+#if POS2_TRACK_PATTERNS
+    TestTrackPatterns();
+#endif
     TestIU();
     TestMpc();
     TestBitExtract();
@@ -10,6 +10,7 @@
 #include "core/MPCStats.h"
 
 #include "Search.h"
+#include "SearchThreads.h"
 #include "Evaluator.h"
 
 const int nAbortCheck=1<<14; // check for aborts every few evals
@@ -18,6 +19,7 @@ const int nAbortCheck=1<<14; // check for aborts every few evals
 extern int hSort;
 int hSolveNoParity=6;
 extern int hNegascout;
+extern int hSplit;
 
 // debugging constants
 extern int nEmptyCNAPrint;
@@ -103,18 +105,16 @@ void InitFFBonus() {
 ///////////////////////////////////////////////////////////////////////
 
 
-CValue StaticValue(Pos2& pos2, int iff) {
-    int pass;
-    u4 nMovesPlayer, nMovesOpponent;
-    CValue result = 0;
-    assert(evaluator);
+//! Count an evaluation, check for timeout, and capture the position if we're doing that.
+//! \return false if the search has been aborted
+inline bool CountEval(const Pos2& pos2) {
     nEvalsQuick++;
 
     // check for out-of-time condition
     if (nEvalsQuick>=nAbortCheck) {
         WipeNodeStats();
         if (CheckAbort(false))
-            return 0;
+            return false;
     }
 
     // capture position if we're doing that
@@ -123,6 +123,37 @@ CValue StaticValue(Pos2& pos2, int iff) {
         pos2.GetBB().Write(cpFile);
         SetRandomCapture();
     }
+    return true;
+}
+
+//! Add the fastest-first adjustment to a static value
+inline CValue FastestFirst(CValue result, u4 nMovesPlayer, int iff) {
+    if (false) {
+        // Constrain value to be in [-kMaxHeuristic, kMaxHeuristic]
+        if (result<-kMaxHeuristic)
+            result=-kMaxHeuristic;
+        else if (result>kMaxHeuristic)
+            result=kMaxHeuristic;
+    }
+
+    if (fTableFF) {
+        if (iff)
+            result+=ffBonus[nMovesPlayer];
+    }
+    else
+        result+=CValue((nMovesPlayer<<iff)-nMovesPlayer);
+
+    return result;
+}
+
+CValue StaticValue(Pos2& pos2, int iff) {
+    int pass;
+    u4 nMovesPlayer, nMovesOpponent;
+    CValue result = 0;
+    assert(evaluator);
+
+    if (!CountEval(pos2))
+        return 0;
 
     // calculate mobility
     pass=pos2.CalcMobility(nMovesPlayer, nMovesOpponent);
@@ -134,32 +165,61 @@ CValue StaticValue(Pos2& pos2, int iff) {
         break;
     case 1:
         pos2.PassBase();
-        result=-evaluator->EvalMobs(pos2, nMovesOpponent, nMovesPlayer);
+        result=-evaluator->Eval(pos2, nMovesOpponent, nMovesPlayer);
         pos2.PassBase();
         break;
     case 0:
-        result=evaluator->EvalMobs(pos2, nMovesPlayer, nMovesOpponent);
+        result=evaluator->Eval(pos2, nMovesPlayer, nMovesOpponent);
         break;
     default:
         assert(false);
     }
 
-    if (false) {
-        // Constrain value to be in [-kMaxHeuristic, kMaxHeuristic]
-        if (result<-kMaxHeuristic)
-            result=-kMaxHeuristic;
-        else if (result>kMaxHeuristic)
-            result=kMaxHeuristic;
-    }
+    return FastestFirst(result, nMovesPlayer, iff);
+}
 
-    if (fTableFF) {
-        if (iff)
-            result+=ffBonus[nMovesPlayer];
+//! Set values[i] to StaticValue(positions[i], iff) for each of the n positions.
+//!
+//! The positions are evaluated in one EvalMobsBatch() call, so their evaluator table lookups
+//!    overlap instead of each waiting on the previous one.
+void StaticValues(Pos2 positions[], int n, int iff, CValue values[]) {
+    u4 nMovesPlayer[64], nMovesOpponent[64];
+    u4 nMovesEvaluated[2][64]={};
+    int passes[64];
+    assert(evaluator && n<=64);
+
+    for (int i=0; i<n; i++) {
+        if (!CountEval(positions[i])) {
+            std::fill(values, values+n, 0);
+            return;
+        }
+        passes[i]=positions[i].CalcMobility(nMovesPlayer[i], nMovesOpponent[i]);
+        // a position where the mover must pass is valued from the opponent's point of view
+        if (passes[i]==1) {
+            positions[i].PassBase();
+            nMovesEvaluated[0][i]=nMovesOpponent[i];
+            nMovesEvaluated[1][i]=nMovesPlayer[i];
+        }
+        else {
+            nMovesEvaluated[0][i]=nMovesPlayer[i];
+            nMovesEvaluated[1][i]=nMovesOpponent[i];
+        }
     }
-    else
-        result+=CValue((nMovesPlayer<<iff)-nMovesPlayer);
 
-    return result;
+    evaluator->EvalMobsBatch(positions, nMovesEvaluated[0], nMovesEvaluated[1], n, values);
+
+    for (int i=0; i<n; i++) {
+        switch(passes[i]) {
+        case 2:
+            values[i]=positions[i].TerminalValue();
+            break;
+        case 1:
+            positions[i].PassBase();
+            values[i]=-values[i];
+            break;
+        }
+        values[i]=FastestFirst(values[i], nMovesPlayer[i], iff);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -177,7 +237,7 @@ CValue ValueBookCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, C
 
 
     ValueCacheOrTree(pos2, height, alpha, beta, moves, iPrune, best);
-    assert(abortRound || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
+    assert(SearchAborted() || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
 
     return best.value;
 }
@@ -190,7 +250,8 @@ CValue ValueBookCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, C
 void ValueCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves& moves,
                            int iPrune, CMoveValue& best) {
     CValue searchAlpha, searchBeta;
-    CCacheData* cd;
+    CCacheData cd;
+    CCacheEntry* entry;
     u64 hash;
     int iffCache;
 
@@ -204,14 +265,14 @@ void ValueCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
     // Check if the position is in cache
     hash=pos2.GetBB().Hash();
 
-    if ((cd=cache->FindOld(pos2.GetBB(), hash))) {
+    if (cache->FindOld(pos2.GetBB(), hash, height, cd)) {
         // cutoff if we can; otherwise update searchAlpha, searchBeta and set the best move
-        if (cd->Load(height, iPrune, pos2.NEmpty(), alpha, beta, best.move, iffCache, searchAlpha, searchBeta, best.value)) {
+        if (cd.Load(height, iPrune, pos2.NEmpty(), alpha, beta, best.move, iffCache, searchAlpha, searchBeta, best.value)) {
             return;
         }
         assert(searchAlpha<searchBeta);
         moves.SetBest(best.move);
-        assert(pos2.GetBB()==cd->Board());    // consistency check
+        assert(pos2.GetBB()==cd.Board());    // consistency check
     }
     else {
         iffCache=0;
@@ -223,13 +284,14 @@ void ValueCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
         ValueTree(pos2, height, searchAlpha, searchBeta, moves, iffCache, iPrune, best);
     
     // Add to cache if we can
-    if (!abortRound) {
-        cd=cache->FindNew(pos2.GetBB(),hash,height,iPrune, pos2.NEmpty());
-        if (cd) {
-            cd->Store(height, iPrune, pos2.NEmpty(), best.move, iffCache, searchAlpha, searchBeta, best.value);
+    if (!SearchAborted()) {
+        entry=cache->FindNew(pos2.GetBB(),hash,height,iPrune, pos2.NEmpty(), cd);
+        if (entry) {
+            cd.Store(height, iPrune, pos2.NEmpty(), best.move, iffCache, searchAlpha, searchBeta, best.value);
+            entry->Write(cd);
         }
     }
-    assert(abortRound || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
+    assert(SearchAborted() || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -256,7 +318,7 @@ inline bool MPCCheck(Pos2& pos2, int height, CValue alpha, CValue beta, const CM
             bound=CValue((alpha-sd)*cr);
             movesCopy=moves;
             ValueCacheOrTree(pos2, hCheck, bound-1, bound, movesCopy, 0, best);
-            if (abortRound)
+            if (SearchAborted())
                 return false;
             if (best.value<bound) {
                 best.value=alpha;
@@ -269,7 +331,7 @@ inline bool MPCCheck(Pos2& pos2, int height, CValue alpha, CValue beta, const CM
             bound=CValue((beta+sd)*cr);
             movesCopy=moves;
             ValueCacheOrTree(pos2, hCheck, bound, bound+1, movesCopy, 0, best);
-            if (abortRound)
+            if (SearchAborted())
                 return false;
             if (best.value>bound) {
                 best.value=beta;
@@ -307,9 +369,11 @@ inline bool ValueMove(Pos2& pos2, int height, int hChild, CValue alpha, CValue b
     Pos2 save_pos = pos2;
     pos2.MakeMoveBB(move.Square());
     
-    if (pos2.m_stable != save_pos.m_stable) {
-        int score_upper_bound = kStoneValue * (NN - 2 * static_cast<CValue>(pos2.m_stable_opponent));
-        //int score_lower_bound = kStoneValue * (2 * static_cast<CValue>(pos2.m_stable_mover) - NN);
+    // the child's mover keeps its stable discs, which limits the value of the move.
+    //    Only prune if the limit is no better than a move already searched, so that
+    //    the node's value doesn't become a looser bound.
+    if (pos2.m_stable_mover) {
+        const CValue score_upper_bound = kStoneValue * (NN - 2 * static_cast<CValue>(pos2.m_stable_mover));
         if (score_upper_bound <= best.value) {
             pos2 = save_pos;
             return false;
@@ -333,7 +397,7 @@ inline bool ValueMove(Pos2& pos2, int height, int hChild, CValue alpha, CValue b
     pos2 = save_pos; 
 
     // check for termination conditions
-    if (abortRound)
+    if (SearchAborted())
         return true;
     if (vChild>best.value) {
         best.move=move;
@@ -345,6 +409,57 @@ inline bool ValueMove(Pos2& pos2, int height, int hChild, CValue alpha, CValue b
     return false;
 }
 
+///////////////////////////////////////////////////////////////////////
+// CTreeSplit - the remaining moves of a ValueTree node, searched by
+//    several threads. Each thread values its moves with ValueMove()
+//    starting from the best value found so far by any thread.
+///////////////////////////////////////////////////////////////////////
+
+class CTreeSplit : public CSplitPoint {
+public:
+    CTreeSplit(const Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, bool fNegascout,
+               const CMoveValue* moveValues, int nMoves, CMoveValue& best)
+        : CSplitPoint(nMoves), pos2(pos2), height(height), alpha(alpha), beta(beta), iPrune(iPrune),
+          fNegascout(fNegascout), moveValues(moveValues), best(best) {}
+
+protected:
+    void SearchItem(int i) override;
+
+private:
+    const Pos2 pos2;
+    const int height;
+    const CValue alpha, beta;
+    const int iPrune;
+    const bool fNegascout;
+    const CMoveValue* const moveValues;
+    CMoveValue& best;    // shared between threads, protected by mutex
+};
+
+void CTreeSplit::SearchItem(int i) {
+    Pos2 pos2Thread(pos2);
+    CMoves moves;
+    CMove move=moveValues[i].move;
+    CMoveValue bestThread;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bestThread=best;
+    }
+    // another thread may have found a cutoff since this item was handed out
+    if (bestThread.value>=beta)
+        return;
+
+    ValueMove(pos2Thread, height, height-1, alpha, beta, move, moves, iPrune, fNegascout && bestThread.value>=alpha, bestThread);
+    if (SearchAborted())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bestThread.value>best.value) {
+        best=bestThread;
+        if (best.value>=beta)
+            Cutoff();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////
 // ValueTree - do a tree search to find the best move and value.
 ///////////////////////////////////////////////////////////////////////
@@ -366,7 +481,6 @@ inline void GetSearchParameters(Pos2& pos2, int height, bool fHasBest, int iPrun
 
 inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves& moves, int& iffCache,
                       int iPrune, CMoveValue& best) {
-    CValue vSubnode;
     CMove    move;
     bool fSort, fSortQuick, fUseBest, fNegascout;
     int iff;
@@ -393,33 +507,39 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
         iffCache=iff;
         //cout << "--- sort ---\n";
         assert(moves.Consistent());
+        // make all the moves first, so the children's cache buckets are all prefetched
+        //    while the children are evaluated
+        Pos2 children[64];
+        u64 hashes[64];
         for (nMoves=0; moves.GetNext(move); nMoves++) {
             moveValues[nMoves].move=move;
-            Pos2 save_pos = pos2;
-            pos2.MakeMoveBB(move.Square());
+            children[nMoves]=pos2;
+            children[nMoves].MakeMoveBB(move.Square());
             if (fSortQuick) {
                 // I tried giving a bonus for playing corner squares but it didn't help.
-                vSubnode=pos2.GetBB().NMoverMobilities();
+                moveValues[nMoves].value=-CValue(children[nMoves].GetBB().NMoverMobilities());
             }
             else {
-                cache->Prefetch(pos2.GetBB().Hash());
-                // Get move values with fastest-first adjustment.
-                vSubnode=StaticValue(pos2, iff);
-
+                hashes[nMoves]=children[nMoves].GetBB().Hash();
+                cache->Prefetch(hashes[nMoves], height-1);
+            }
+        }
+        if (!fSortQuick) {
+            // Get move values with fastest-first adjustment.
+            CValue values[64];
+            StaticValues(children, nMoves, iff, values);
+            for (i=0; i<nMoves; i++) {
                 // Check for ETC (Enhanced Transposition Cutoff). If the move will cause an
                 // immediate hash-table cutoff, we want to do it first.
-                CCacheData* pcd = cache->FindOld(pos2.GetBB(),pos2.GetBB().Hash());
-                if (pcd && pcd->AlphaCutoff(height-1, iPrune, pos2.NEmpty(), -beta)) {
-                    vSubnode-=50*kStoneValue;
+                CCacheData cd;
+                if (cache->FindOld(children[i].GetBB(), hashes[i], height-1, cd) && cd.AlphaCutoff(height-1, iPrune, children[i].NEmpty(), -beta)) {
+                    values[i]-=50*kStoneValue;
                 }
+                moveValues[i].value=-values[i];
             }
-            moveValues[nMoves].value=-vSubnode;
-            //Print(m_fBlackMove_);
-            //cout << "Value = " << vSubnode << "\n";
-            pos2 = save_pos;
         }
 
-        if (abortRound) {
+        if (SearchAborted()) {
             return;
         }
 
@@ -427,6 +547,12 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
 
         // test remaining moves in order
         for (i=0; i<nMoves; i++) {
+            // Young brothers wait: once the eldest brother is searched, idle threads may help with the rest
+            if (nChecked && height>=hSplit && i+1<nMoves && IdleSearchThread()) {
+                CTreeSplit split(pos2, height, alpha, beta, iPrune, fNegascout, moveValues+i, nMoves-i, best);
+                split.Search();
+                return;
+            }
             move=moveValues[i].move;
             bool fCutoff=ValueMove(pos2, height, hChild, alpha, beta, move, moves, iPrune, fNegascout && nChecked && best.value>=alpha, best);
             if (fCutoff) {
@@ -446,11 +572,38 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
     }
 }
 
-inline int MmxSolve(CBitBoard m_bb, int alpha, int beta) {
+//! Static value of a position to the mover, for ordering moves in the n64 solver.
+//! Positions where the mover must pass are valued as they stand.
+int SolverOrderingEval(u64 mover, u64 enemy) {
+    Pos2 pos2;
+    pos2.m_bb.mover=mover;
+    pos2.m_bb.empty=~(mover|enemy);
+    u4 nMovesPlayer, nMovesOpponent;
+    pos2.CalcMobility(nMovesPlayer, nMovesOpponent);
+    return evaluator->EvalMobs(pos2, nMovesPlayer, nMovesOpponent);
+}
+
+// If fCached, the position is looked up in and stored to the cache, so the solver doesn't need
+//    its own hash table for it.
+inline int MmxSolve(CBitBoard m_bb, int alpha, int beta, bool fCached) {
     const u64 enemy = m_bb.getEnemy();
-    return solveNValue(alpha, beta, m_bb.mover, enemy);
+    return solveNValue(alpha, beta, m_bb.mover, enemy, !fCached);
 }
 
+///////////////////////////////////////////////////////////////////////
+// SolveValue - solve a subposition with the n64 solver
+// inputs:
+//    alpha, beta - cutoffs as values to the node's mover
+// returns:
+//    child value of the subposition, or bound if cutoff
+//
+// Solves from hSolverStart empties, where the midgame search hands over to the solver,
+//    are stored in the cache as exact solves of height 0, so a transposition reached
+//    again is not solved twice. Only this function's probe reads them: the midgame's
+//    probes are of positions with more empties, and height-0 entries aren't Loadable()
+//    for a height above 0. Positions with fewer empties only occur when the search
+//    starts there and are cheap to solve.
+///////////////////////////////////////////////////////////////////////
 inline CValue SolveValue(Pos2& pos2, CValue alpha, CValue beta) {
     if (nSNodesQuick>=(nAbortCheck<<4)) {
         WipeNodeStats();
@@ -458,10 +611,35 @@ inline CValue SolveValue(Pos2& pos2, CValue alpha, CValue beta) {
             return 0;
         }
     }
-    const int mmxBeta=int((beta+10099)/100)-100;
-    const int mmxAlpha=int((alpha+10000)/100)-100;
-    const CValue result=-MmxSolve(pos2.GetBB(), -mmxBeta, -mmxAlpha)*kStoneValue;
 
+    // values in the cache are from the subposition mover's point of view
+    const CBitBoard& bb=pos2.GetBB();
+    const int nEmpty=pos2.NEmpty();
+    const bool fCached=nEmpty==hSolverStart;
+    CCacheData cd;
+    CMove move;
+    int iffCache;
+    CValue searchAlpha=-beta, searchBeta=-alpha, value;
+    const u64 hash=fCached ? bb.Hash() : 0;
+    if (fCached && cache->FindOld(bb, hash, 0, cd)
+        && cd.Load(0, 0, nEmpty, -beta, -alpha, move, iffCache, searchAlpha, searchBeta, value)) {
+        return -value;
+    }
+
+    const int mmxBeta=int((searchBeta+10099)/100)-100;
+    const int mmxAlpha=int((searchAlpha+10000)/100)-100;
+    value=MmxSolve(bb, mmxAlpha, mmxBeta, fCached)*kStoneValue;
+
+    if (fCached && !SearchAborted()) {
+        CCacheEntry* entry=cache->FindNew(bb, hash, 0, 0, nEmpty, cd);
+        if (entry) {
+            // the solver doesn't report its best move
+            cd.Store(0, 0, nEmpty, CMove(-1), 0, searchAlpha, searchBeta, value);
+            entry->Write(cd);
+        }
+    }
+
+    const CValue result=-value;
     assert(result>-kInfinity);
     return result;
 }
@@ -496,17 +674,17 @@ CValue ChildValue(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune)
     else {
         CMoves moves;
         int pass;
-        cache->Prefetch(pos2.GetBB().Hash());
+        cache->Prefetch(pos2.GetBB().Hash(), height);
         pass=pos2.CalcMovesAndPassBB(moves);
 
         switch(pass) {
         case 0:
             result=-ValueBookCacheOrTree(pos2, height, -beta, -alpha, moves, iPrune);
-            assert(result>-kInfinity || abortRound);
+            assert(result>-kInfinity || SearchAborted());
             break;
         case 1:
             result=ValueBookCacheOrTree(pos2, height, alpha, beta, moves, iPrune);
-            assert(result>-kInfinity || abortRound);
+            assert(result>-kInfinity || SearchAborted());
             break;
         case 2:
             result=pos2.TerminalValue();
@@ -679,9 +857,10 @@ void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u
     // If we had a beta cutoff,some moves weren't even tried, put them last.
     mvsEvaluated.insert(mvsEvaluated.end(),i,mvs.end());
 }
-//! Make the cache stale so it doesn't get blocked up
+//! Make the caches stale so they don't get blocked up
 void InitializeCache() {
     cache->SetStale();
+    solverHash().newSearch();
 }
 
 int iffMidgame=5;
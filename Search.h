@@ -17,6 +17,11 @@ void SetBookHeights(int height);
 void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves& moves, int& iFastestFirst, int iPrune, CMoveValue& best);
 
 CValue StaticValue(Pos2& pos2, int iff);
+void StaticValues(Pos2 positions[], int n, int iff, CValue values[]);
+
+// n64 solver move ordering by evaluator, see setOrderingEval()
+int SolverOrderingEval(u64 mover, u64 enemy);
+const int solverOrderingMinEmpties=12;
 
 // forced openings
 void InitForcedOpenings();
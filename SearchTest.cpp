@@ -1,13 +1,18 @@
 #include <vector>
 #include <iomanip>
 #include "n64/test.h"
+#include "n64/solve.h"
 #include "core/Cache.h"
+#include "core/CalcParams.h"
 #include "core/MPCStats.h"
+#include "core/options.h"
 #include "core/BitBoardTest.h"
 #include "SpeedTest.h"
 #include "Search.h"
+#include "SearchThreads.h"
 #include "Evaluator.h"
 #include "PlayerComputer.h"
+#include "options.h"
 
 
 const int nEndgames=113;
@@ -141,13 +146,14 @@ TSolverPosition bds[nEndgames] = {
 
 const int printDetails = 0; // 1 = 1-line output per position, 2=print board and other info
 
-void TestEndgameAccuracy(){
+void TestEndgameAccuracy(int nThreads){
 	int i;
 	CNodeStats start,end, start1,end1,delta1;
 	CValue value;
 
 	// create computer
 	CComputerDefaults cd;
+	cd.nThreads=nThreads;
 	CPlayerComputer computer(cd);
 
 	start.Read();
@@ -192,6 +198,39 @@ void TestEndgameAccuracy(){
 	if (printDetails) {
 		std::cout << end-start << "\n";
 	}
+	SetSearchThreads(1);
+}
+
+// The n64 solver gets the same results when it orders moves with the evaluator
+void TestSolverOrderingEval() {
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	setOrderingEval(SolverOrderingEval, 0);
+	for (int i=0; i<nEndgames && bds[i].board[0]; i++) {
+		CBitBoard bb;
+		bb.Initialize(bds[i].board, false);
+		assertEquals(bds[i].nResultNoEmpties, solveNValue(-64, 64, bb.mover, bb.getEnemy()));
+	}
+	setOrderingEval(0, 0);
+}
+
+// Selective solves of the test endgames get the right winner
+void TestSelectiveSolve() {
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	setOrderingEval(SolverOrderingEval, solverOrderingMinEmpties);
+	const int probCutMinEmptiesSave = probCutMinEmpties;
+	probCutMinEmpties = 9;
+	for (int i=0; i<nEndgames && bds[i].board[0]; i++) {
+		CBitBoard bb;
+		bb.Initialize(bds[i].board, false);
+		const int expected = bds[i].nResultNoEmpties;
+		const int result = solveNValueSelective(-64, 64, bb.mover, bb.getEnemy(), 2);
+		if (expected)
+			assertEquals(Sign(expected), Sign(result));
+		// cutoffs this unlikely never happen
+		assertEquals(expected, solveNValueSelective(-64, 64, bb.mover, bb.getEnemy(), 100));
+	}
+	probCutMinEmpties = probCutMinEmptiesSave;
+	setOrderingEval(0, 0);
 }
 
 std::vector<CMoveValue> createMoves(CQPosition testPosition) {
@@ -205,6 +244,80 @@ std::vector<CMoveValue> createMoves(CQPosition testPosition) {
     return mvs;
 }
 
+CValue ChildValue(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune);
+
+//! The position handed over to the solver is stored in the cache, so a second solve of it is a cache hit
+//!    and doesn't run the solver.
+static void TestSolverHandoverCache() {
+	CCache acache(1024);
+	cache = &acache;
+	InitializeCache();
+
+	const CQPosition testPosition = PositionFromEmpties(LoadTestGames().at(0), hSolverStart);
+	Pos2 pos2;
+	pos2.Initialize(testPosition.BitBoard(), testPosition.BlackMove());
+
+	CNodeStats start, solved, cached;
+	start.Read();
+	const double nHitsStart = nTierHits[0];
+	const CValue value = ChildValue(pos2, 0, -kInfinity, kInfinity, 0);
+	solved.Read();
+	const double nHitsSolved = nTierHits[0];
+	assertTrue((solved-start).nSNodes > 0);
+
+	assertEquals(value, ChildValue(pos2, 0, -kInfinity, kInfinity, 0));
+	cached.Read();
+	assertEquals(0, (cached-solved).nSNodes);
+	assertEquals(0, nHitsSolved-nHitsStart);
+	assertEquals(1, nTierHits[0]-nHitsSolved);
+
+	cache = NULL;
+}
+
+//! ETC in ValueTree(): a child whose cache entry refutes the position is searched first, whatever its
+//!    static value. Then no other child is searched, so the only evaluations are the sort's.
+static void TestValueTreeEtc() {
+	const CQPosition testPosition = PositionFromEmpties(LoadTestGames().at(0), 20);
+	Pos2 pos2;
+	pos2.Initialize(testPosition.BitBoard(), testPosition.BlackMove());
+	const int height = 3;
+	const CValue alpha = 0, beta = 1;
+
+	u64 moveBits = mobility(pos2.GetBB().mover, pos2.GetBB().getEnemy());
+	const int nMoves = bitCountInt(moveBits);
+	assertTrue(nMoves >= 2);
+	while (moveBits) {
+		const int sq = popLowBit(moveBits);
+		CCache acache(1024);
+		cache = &acache;
+		InitializeCache();
+
+		// the child is a loss for its mover
+		Pos2 child = pos2;
+		child.MakeMoveBB(sq);
+		const CBitBoard& bb = child.GetBB();
+		CCacheData cd;
+		CCacheEntry* entry = cache->FindNew(bb, bb.Hash(), height-1, 0, child.NEmpty(), cd);
+		assertTrue(entry != NULL);
+		CValue value = -30*kStoneValue;
+		cd.Store(height-1, 0, child.NEmpty(), CMove(-1), 0, -kInfinity, kInfinity, value);
+		entry->Write(cd);
+
+		CMoves moves;
+		pos2.CalcMoves(moves);
+		int iffCache = 0;
+		CMoveValue best;
+		CNodeStats start, end;
+		start.Read();
+		ValueTree(pos2, height, alpha, beta, moves, iffCache, 0, best);
+		end.Read();
+		assertEquals(sq, best.move.Square());
+		assertTrue(best.value >= beta);
+		assertEquals(nMoves, (end-start).nEvals);
+	}
+	cache = NULL;
+}
+
 void TestIterativeValue(int depth) {
 	CCache acache(2);
 	cache = &acache;
@@ -244,14 +357,91 @@ void TestStaticValue() {
 		pos2.InitializeToStartPosition();
 		for (u4 i=0; i<ml.size(); i++) {
 			const COsMove& mv = ml.at(i).mv;
+			if (mv.Pass()) {
+				pos2.PassBB();
+				continue;
+			}
 			int square = Square(mv.Row(), mv.Col());
 			pos2.MakeMoveBB(square);
 		}
 	}
 }
 
+// StaticValues() must give each child the value StaticValue() gives it, including children where the mover passes
+void TestStaticValues() {
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	// the evaluators return 0 once the search times out
+	SetAbortTime(1e6);
+	const std::vector<COsGame> testGames = LoadTestGames();
+	for (size_t iGame=0; iGame<100 && iGame<testGames.size(); iGame++) {
+		const COsGame& game = testGames[iGame];
+		Pos2 pos2;
+		pos2.InitializeToStartPosition();
+		for (u4 i=0; i<game.ml.size(); i++) {
+			const COsMove& mv = game.ml.at(i).mv;
+			if (mv.Pass()) {
+				pos2.PassBB();
+				continue;
+			}
+			Pos2 children[64];
+			int nChildren = 0;
+			u64 moves = mobility(pos2.GetBB().mover, pos2.GetBB().getEnemy());
+			while (moves) {
+				children[nChildren] = pos2;
+				children[nChildren].MakeMoveBB(popLowBit(moves));
+				nChildren++;
+			}
+			for (int iff = 0; iff <= 1; iff++) {
+				CValue values[64];
+				StaticValues(children, nChildren, iff, values);
+				for (int j=0; j<nChildren; j++) {
+					Pos2 child = children[j];
+					assertEquals(StaticValue(child, iff), values[j]);
+				}
+			}
+			pos2.MakeMoveBB(Square(mv.Row(), mv.Col()));
+		}
+	}
+}
+
+//! Change the cache budget between two searches; the computer should resize its cache to fit
+static void TestCacheMem() {
+	const uint64_t maxCacheMemSave=maxCacheMem;
+	CComputerDefaults cd;
+	CPlayerComputer computer(cd);
+
+	const TSolverPosition& bd=bds[nEndgames-1];
+	Pos2 pos2;
+	pos2.Initialize(bd.board, false);
+	const CQPosition qpos(pos2.GetBB(), pos2.BlackMove());
+	const CSearchInfo si=computer.DefaultSearchInfo(false, CSearchInfo::kNeedValue+CSearchInfo::kNeedMove, 1e6, 0);
+	CMVK mvk;
+
+	for (uint64_t bytes : {1ULL<<20, 4ULL<<20, 1ULL<<20}) {
+		SetCacheMem(bytes);
+		computer.GetChosen(si, qpos, mvk);
+		assertEquals(CPlayerComputer::CacheEntries(), ::cache->NEntries());
+		assertEquals(bytes, ::cache->NEntries()*sizeof(CCacheEntry));
+		assertEquals(bd.nResultNoEmpties, mvk.value/kStoneValue);
+	}
+
+	SetCacheMem(maxCacheMemSave);
+}
+
 void TestSearch() {
 	TestStaticValue();
+	TestStaticValues();
+	TestSolverHandoverCache();
+	TestValueTreeEtc();
 	TestIterativeValue();
-	TestEndgameAccuracy();
+	TestEndgameAccuracy(1);
+	TestSolverOrderingEval();
+	TestSelectiveSolve();
+	TestCacheMem();
+
+	// split as low as possible so the parallel search is exercised by these small endgames
+	const int hSplitSave=hSplit;
+	hSplit=2;
+	TestEndgameAccuracy(4);
+	hSplit=hSplitSave;
 }
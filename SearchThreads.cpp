@@ -0,0 +1,162 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Helper threads for parallel tree search
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "SearchThreads.h"
+
+thread_local CSplitPoint* splitPoint=0;
+
+//! Pool of helper threads. Idle helpers wait for split points with unstarted items.
+class CSearchThreads {
+public:
+    ~CSearchThreads() { Stop(); }
+
+    void Start(int nHelpers);
+    void Stop();
+    int NHelpers() const { return int(helpers.size()); }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<CSplitPoint*> splitPoints;    // split points currently being searched, oldest first
+    std::atomic<int> nIdle{0};
+
+private:
+    void HelperLoop();
+    CSplitPoint* FindWork(int& i);
+
+    std::vector<std::thread> helpers;
+    bool fQuit=false;
+};
+
+static CSearchThreads searchThreads;
+
+void CSearchThreads::Start(int nHelpers) {
+    for (int i=0; i<nHelpers; i++)
+        helpers.emplace_back(&CSearchThreads::HelperLoop, this);
+}
+
+void CSearchThreads::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fQuit=true;
+        cv.notify_all();
+    }
+    for (std::thread& helper : helpers)
+        helper.join();
+    helpers.clear();
+    fQuit=false;
+}
+
+// Find an unstarted item. Prefer the oldest split point since it is nearest the root and has the largest subtrees.
+// Must be called with the mutex held.
+CSplitPoint* CSearchThreads::FindWork(int& i) {
+    for (CSplitPoint* sp : splitPoints) {
+        if (sp->NextItem(i))
+            return sp;
+    }
+    return 0;
+}
+
+void CSearchThreads::HelperLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!fQuit) {
+        int i;
+        CSplitPoint* sp=FindWork(i);
+        if (sp) {
+            lock.unlock();
+            sp->RunItem(i);
+            WipeNodeStats();
+            lock.lock();
+            if (--sp->nWorking==0)
+                cv.notify_all();
+        }
+        else {
+            nIdle++;
+            cv.wait(lock);
+            nIdle--;
+        }
+    }
+}
+
+//////////////////////////////////////////////
+// CSplitPoint
+//////////////////////////////////////////////
+
+CSplitPoint::CSplitPoint(int anItems) : nItems(anItems), iNext(0), nWorking(0), fCutoff(false), parent(splitPoint) {
+}
+
+bool CSplitPoint::Aborted() const {
+    for (const CSplitPoint* sp=this; sp; sp=sp->parent) {
+        if (sp->fCutoff)
+            return true;
+    }
+    return false;
+}
+
+// Get the next unstarted item. Must be called with the pool mutex held.
+bool CSplitPoint::NextItem(int& i) {
+    if (iNext>=nItems || Aborted())
+        return false;
+    i=iNext++;
+    nWorking++;
+    return true;
+}
+
+void CSplitPoint::RunItem(int i) {
+    CSplitPoint* const saved=splitPoint;
+    splitPoint=this;
+    SearchItem(i);
+    splitPoint=saved;
+}
+
+void CSplitPoint::Search() {
+    std::unique_lock<std::mutex> lock(searchThreads.mutex);
+    searchThreads.splitPoints.push_back(this);
+    searchThreads.cv.notify_all();
+
+    for (;;) {
+        int i;
+        if (NextItem(i)) {
+            lock.unlock();
+            RunItem(i);
+            lock.lock();
+            nWorking--;
+        }
+        else if (nWorking==0)
+            break;
+        else
+            searchThreads.cv.wait(lock);
+    }
+
+    std::vector<CSplitPoint*>& sps=searchThreads.splitPoints;
+    sps.erase(std::find(sps.begin(), sps.end(), this));
+}
+
+//////////////////////////////////////////////
+// Thread count
+//////////////////////////////////////////////
+
+int NSearchThreads() {
+    return searchThreads.NHelpers()+1;
+}
+
+//! Must not be called while a search is running.
+void SetSearchThreads(int nThreads) {
+    const int nHelpers=std::max(nThreads, 1)-1;
+    if (nHelpers!=searchThreads.NHelpers()) {
+        searchThreads.Stop();
+        searchThreads.Start(nHelpers);
+    }
+}
+
+bool IdleSearchThread() {
+    return searchThreads.nIdle.load(std::memory_order_relaxed)>0;
+}
@@ -0,0 +1,65 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Helper threads for parallel tree search
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include "core/NodeStats.h"
+
+//! A node whose remaining subtrees may be searched by several threads at once.
+//!
+//! The thread that owns the node calls Search(). Idle helper threads join it and
+//! call SearchItem() for items nobody has started yet. Search() returns once all
+//! items are finished, or once the split point (or one above it) is cut off and
+//! the items already started have returned.
+class CSplitPoint {
+public:
+    explicit CSplitPoint(int nItems);
+    virtual ~CSplitPoint() {}
+
+    void Search();
+
+    //! Stop handing out items. Searches below this split point see Aborted() and return quickly.
+    void Cutoff() { fCutoff=true; }
+    bool Aborted() const;
+
+protected:
+    //! Search item i. May be called from any search thread.
+    virtual void SearchItem(int i)=0;
+
+    //! Protects results shared between the threads searching this split point
+    std::mutex mutex;
+
+private:
+    bool NextItem(int& i);
+    void RunItem(int i);
+
+    const int nItems;
+    int iNext, nWorking;
+    std::atomic<bool> fCutoff;
+    CSplitPoint* const parent;
+
+    friend class CSearchThreads;
+};
+
+//! The split point the current thread is searching below, or NULL if none
+extern thread_local CSplitPoint* splitPoint;
+
+//! true if the round was aborted or the subtree this thread is searching is no longer needed
+inline bool SearchAborted() {
+    return abortRound || (splitPoint && splitPoint->Aborted());
+}
+
+//! Total number of search threads, including the main thread
+int NSearchThreads();
+
+//! Set the total number of search threads, including the main thread.
+void SetSearchThreads(int nThreads);
+
+//! true if a helper thread is waiting for work, so splitting a node would be useful
+bool IdleSearchThread();
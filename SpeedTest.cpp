@@ -54,7 +54,7 @@ const int kPrintScrzebra=2;
 const int kPrintValues=4;
 const int kOnlyFinalRound=8;
 
-void TestMidgameSpeed(int nEmpty, CHeightInfo hi, int nGames, int flags) {
+void TestMidgameSpeed(int nEmpty, CHeightInfo hi, int nGames, int flags, int nThreads=1) {
     double tRun, tTotal, geoMean;
     CNodeStats start, end, start1, end1;
     CCalcParamsFixedHeight pcp(hi);
@@ -65,12 +65,14 @@ void TestMidgameSpeed(int nEmpty, CHeightInfo hi, int nGames, int flags) {
 
     // setup computer
     cd.fsPrint=-1;
+    cd.nThreads=nThreads;
     CPlayerComputer computer(cd);
     pcpOld=computer.pcp;
     computer.pcp=&pcp;
 
     // initialize stats
     start.Read();
+    CCache::ClearTierStats();
     geoMean=tTotal=0;
     nCorrect=0;
 
@@ -79,6 +81,8 @@ void TestMidgameSpeed(int nEmpty, CHeightInfo hi, int nGames, int flags) {
         hi.SetNEmpty(nEmpty);
         cout << "Testing " << (hi.IsKnownProbableSolve() ? "endgame" : "midgame") << " from " << nEmpty << " empties\n";
         cout << "Height: " << hi << "\n";
+        if (nThreads>1)
+            cout << "Threads: " << nThreads << "\n";
     }
     else {
         cout << hi << "\t" << nEmpty << "\t" << nGames << "\n";
@@ -154,6 +158,7 @@ void TestMidgameSpeed(int nEmpty, CHeightInfo hi, int nGames, int flags) {
         cout << "\n";
 
         cout << end-start << "\n";
+        CCache::PrintTierStats();
     }
     else {
         cout << nCorrect << "\t" << tTotal/nGames << "\n";
@@ -214,3 +219,100 @@ void TestMoveSpeed(int end_depth, int mid_depth) {
     const int hMidgame=mid_depth;
     TestMidgameSpeed(36, CHeightInfo(hMidgame,4,false), 1000, kPrintTestHeader);
 }
+
+//! Run the move speed test with fTrack on and off, and print nodes per search and speed for each
+static void TestTrackingSpeed(bool& fTrack, const char* name, int end_depth, int mid_depth) {
+    const bool fTrackSave=fTrack;
+    for (int track=1; track>=0; track--) {
+        fTrack=track!=0;
+        CNodeStats start, end;
+        start.Read();
+        TestMoveSpeed(end_depth, mid_depth);
+        end.Read();
+        const CNodeStats delta=end-start;
+        // TestMoveSpeed searches 1000 endgame and 1000 midgame positions
+        cout << name << " " << (track ? "on" : "off") << ": "
+             << eng(delta.Nodes()/2000) << " nodes/search, "
+             << eng(delta.Nodes()/delta.Seconds()) << "n/s\n";
+    }
+    fTrack=fTrackSave;
+}
+
+//! Run the move speed test with incremental stable disc tracking on and off, and print nodes per search and speed for each
+void TestStableSpeed(int end_depth, int mid_depth) {
+    TestTrackingSpeed(Pos2::fTrackStable, "stable disc tracking", end_depth, mid_depth);
+}
+
+//! Run the move speed test with incremental pattern tracking on and off, and print nodes per search and speed for each
+//!
+//! The evaluations are the same either way, so the node counts should match.
+void TestPatternSpeed(int end_depth, int mid_depth) {
+#if POS2_TRACK_PATTERNS
+    TestTrackingSpeed(Pos2::fTrackPatterns, "pattern tracking", end_depth, mid_depth);
+#else
+    cout << "pattern tracking is not built in; build with POS2_TRACK_PATTERNS=1\n";
+#endif
+}
+
+//! Time the static evaluator on every position of the test games, and print the time per evaluation
+//!
+//! The checksum is the sum of all the evaluations; it must not depend on which EvalMobs variant runs.
+void TestEvalSpeed(int nRepeats) {
+    struct EvalInput {
+        Pos2 pos2;
+        u4 nMovesPlayer, nMovesOpponent;
+    };
+
+    const CEvaluator* const eval=CEvaluator::FindEvaluator('J','A');
+    std::vector<EvalInput> inputs;
+    for (const COsGame& game : LoadTestGames()) {
+        CQPosition pos;
+        pos.Initialize();
+        for (size_t iMove=0; iMove<game.ml.size(); iMove++) {
+            pos.MakeMove(game.ml[iMove].mv);
+            if (pos.NEmpty()==0)
+                break;
+            const CBitBoard& bb=pos.BitBoard();
+            EvalInput input;
+            input.pos2.Initialize(bb, pos.BlackMove());
+            input.nMovesPlayer=u4(bitCount(mobility(bb.mover, bb.getEnemy())));
+            input.nMovesOpponent=u4(bitCount(mobility(bb.getEnemy(), bb.mover)));
+            inputs.push_back(input);
+        }
+    }
+
+    i8 checksum=0;
+    CNodeStats start, end;
+    start.Read();
+    for (int i=0; i<nRepeats; i++) {
+        for (const EvalInput& input : inputs)
+            checksum+=eval->EvalMobs(input.pos2, input.nMovesPlayer, input.nMovesOpponent);
+    }
+    end.Read();
+    const double nEvals=double(inputs.size())*nRepeats;
+    cout << inputs.size() << " positions x " << nRepeats << ": "
+         << (end-start).Seconds()*1e9/nEvals << "ns/eval, checksum " << checksum << "\n";
+}
+
+//! Run the midgame test while checking every cache hit against the stored board, and print the false-hit rate
+void TestCacheFalseHits(int mid_depth, int nGames) {
+    CCache::VerifyHits(true);
+    TestMidgameSpeed(36, CHeightInfo(mid_depth,4,false), nGames, kPrintTestHeader);
+    CCache::PrintHitStats();
+    CCache::VerifyHits(false);
+}
+
+//! Time the midgame test at increasing thread counts and print the speedup over one thread
+void TestParallelSpeed(int mid_depth, int nGames) {
+    double tSerial=0;
+    for (int nThreads=1; nThreads<=8; nThreads*=2) {
+        CNodeStats start, end;
+        start.Read();
+        TestMidgameSpeed(36, CHeightInfo(mid_depth,4,false), nGames, kPrintTestHeader, nThreads);
+        end.Read();
+        const double t=(end-start).Seconds();
+        if (nThreads==1)
+            tSerial=t;
+        cout << nThreads << " threads: " << t << "s, speedup " << tSerial/t << "\n";
+    }
+}
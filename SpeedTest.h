@@ -8,4 +8,9 @@
 #pragma once
 #include "core/QPosition.h"
 void TestMoveSpeed(int end_depth = 26, int mid_depth = 26);
+void TestParallelSpeed(int mid_depth, int nGames);
+void TestStableSpeed(int end_depth, int mid_depth);
+void TestPatternSpeed(int end_depth, int mid_depth);
+void TestEvalSpeed(int nRepeats);
+void TestCacheFalseHits(int mid_depth, int nGames);
 CQPosition PositionFromEmpties(const COsGame& game, int nEmpty);
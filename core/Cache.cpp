@@ -7,10 +7,14 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
+#include <new>
+#include <string>
 
 #include "../port.h"
 #include "options.h"
+#include "NodeStats.h"
 #include "Cache.h"
 
 using namespace std;
@@ -75,6 +79,15 @@ bool CCacheData::Replaceable(int aHeight, int aPrune, int anEmpty) const {
     return Importance(aHeight, aPrune, anEmpty)>Importance(height,iPrune, nEmpty);
 }
 
+// an entry loses this many plies of importance for each generation it goes unused
+const int hAgePenalty=2;
+
+// priority for keeping the entry when a new position needs room; the lowest priority entry is replaced
+int CCacheData::Priority(u2 aGeneration) const {
+    const int agePenalty=Importance(hAgePenalty, 0, NN)-Importance(0, 0, NN);
+    return Importance(height, iPrune, nEmpty)-agePenalty*Age(aGeneration);
+}
+
 bool CCacheData::Load(int aHeight, int aPrune, int nEmpty, CValue alpha, CValue beta, CMove& aBestMove,
     				   int& aiFastestFirst, CValue& searchAlpha, CValue& searchBeta, CValue& value) {
 
@@ -181,11 +194,12 @@ ostream& CCacheData::OutData(ostream& os) const {
 void CCacheData::Clear() {
     // store an impossible position to prevent collisions
     board.SetImpossible();
-    // make stale to allow overwrites
-    SetStale(0);
     // set other stuff to 0 for debugging purposes
+    generation=0;
+    game=0;
     height=iPrune=nEmpty=iFastestFirst=0;
     lBound=uBound=0;
+    bestMove=CMove(-1);
 }
 
 void CCacheData::Initialize(const CBitBoard& aBoard, int aheight, int aPrune, int vnEmpty) {
@@ -199,9 +213,9 @@ void CCacheData::Initialize(const CBitBoard& aBoard, int aheight, int aPrune, in
     iFastestFirst=0;
 }
 
-void CCacheData::Print(bool blackMove, u1 count) const {
+void CCacheData::Print(bool blackMove, u2 aGeneration) const {
     board.Print(blackMove);
-    printf(isStale(count)?"stale ":"nonstale ");
+    printf(isStale(aGeneration)?"stale ":"nonstale ");
     OutData(cout);
 }
 
@@ -209,40 +223,242 @@ void CCacheData::Print(bool blackMove, u1 count) const {
 // CCache class
 /////////////////////////////////////////////////
 
-CCache::CCache(u4 anbuckets) {
-    fprintf(stderr, "Creating cache with %d buckets (%llu MB)\n",anbuckets, static_cast<unsigned long long>(anbuckets*sizeof(CCacheData)>>20));
-    nBuckets=anbuckets;
-    buckets=reinterpret_cast<CCacheData*>(calloc(sizeof(CCacheData), nBuckets));
-    assert(buckets);
-    assert((nBuckets&(nBuckets-1))==0);
+// Number of buckets for a cache with at most nEntries entries: a power of 2, at least 1
+u4 CCache::NBucketsFor(u64 nEntries) {
+    u4 n=1;
+    while (u64(n)*2*CCacheBucket::nWays<=nEntries && n<(1u<<31))
+    	n*=2;
+    return n;
+}
 
+CCache::CCache(u64 nEntries) {
+    Allocate(NBucketsFor(nEntries));
     Clear();
     ClearStats();
 }
 
 CCache::~CCache() {
-    free(buckets);
+    Free();
+    FreeNearTier();
+    delete[] shadow;
+}
+
+void CCache::Free() {
+    if (mapping)
+    	UnmapFile(mapping, mappingSize);
+    else
+    	LargeFree(buckets, nBuckets*sizeof(CCacheBucket));
+    mapping=nullptr;
+    buckets=nullptr;
+}
+
+// The members are only set once everything is allocated, so if an allocation fails (in Resize(), say)
+//    the cache keeps its old table.
+void CCache::Allocate(u4 anBuckets) {
+    const u64 nBytes=u64(anBuckets)*sizeof(CCacheBucket);
+    CCacheBucket* const newBuckets=reinterpret_cast<CCacheBucket*>(LargeAlloc(nBytes, pageMode));
+    if (!newBuckets)
+    	throw std::string("unable to allocate cache");
+    CBitBoard* newShadow=nullptr;
+    if (fVerifyHits) {
+    	try {
+    		newShadow=new CBitBoard[u64(anBuckets)*CCacheBucket::nWays];
+    	}
+    	catch(const std::bad_alloc&) {
+    		LargeFree(newBuckets, nBytes);
+    		throw std::string("unable to allocate cache");
+    	}
+    }
+    nBuckets=anBuckets;
+    buckets=newBuckets;
+    shadow=newShadow;
+    fprintf(stderr, "Creating cache with %llu entries (%llu MB, %s)\n", static_cast<unsigned long long>(NEntries()),
+    	static_cast<unsigned long long>(nBytes>>20), PageModeName(pageMode));
 }
 
+// Clear all entries. Only needed when the cache is created; between searches, SetStale() is enough.
 void CCache::Clear() {
-    CCacheData* i;
+    for (u2& generation : generations)
+    	generation=0;
+    ClearEntries();
+    ClearEntries(nearBuckets, nNearBuckets, generations[0]);
+}
 
-    for (i=buckets; i<buckets+nBuckets; i++)
-    i->Clear();
-    staleCount=0;
+void CCache::ClearEntries() {
+    ClearEntries(buckets, nBuckets, generations[0]);
 }
 
-int CCache::CopyData(const CCache& cache2) {
-    if (nBuckets!=cache2.nBuckets)
-    	return -2;
-    else {
-    	memcpy(buckets, cache2.buckets, nBuckets*sizeof(CCacheData));
-    	return 0;
+void CCache::ClearEntries(CCacheBucket* buckets, u4 nBuckets, u2 generation) {
+    CCacheData cd;
+
+    cd.Clear();
+    // make stale to allow overwrites
+    cd.SetGeneration(0, generation-1);
+    for (CCacheBucket* bucket=buckets; bucket<buckets+nBuckets; bucket++) {
+    	for (CCacheEntry& entry : bucket->entries)
+    		entry.Write(cd);
+    }
+}
+
+// Set the size of the near-leaf tier and the height below which positions are stored in it.
+//    hNear=0 removes the tier. Must not be called during a search.
+//
+// The near tier's entries are dropped whenever it is resized.
+void CCache::SetNearTier(u64 nNearEntries, int ahNear) {
+    const u4 nNewBuckets=ahNear ? NBucketsFor(nNearEntries) : 0;
+    if (nNewBuckets!=nNearBuckets) {
+    	FreeNearTier();
+    	if (nNewBuckets) {
+    		TPageMode nearPageMode;
+    		nearBuckets=reinterpret_cast<CCacheBucket*>(LargeAlloc(nNewBuckets*sizeof(CCacheBucket), nearPageMode));
+    		if (!nearBuckets)
+    			throw std::string("unable to allocate near cache tier");
+    		nNearBuckets=nNewBuckets;
+    		nearShadow=fVerifyHits ? new CBitBoard[u64(nNearBuckets)*CCacheBucket::nWays] : nullptr;
+    		ClearEntries(nearBuckets, nNearBuckets, generations[0]);
+    	}
+    }
+    hNear=ahNear;
+}
+
+void CCache::FreeNearTier() {
+    if (nearBuckets)
+    	LargeFree(nearBuckets, nNearBuckets*sizeof(CCacheBucket));
+    delete[] nearShadow;
+    nearBuckets=nullptr;
+    nNearBuckets=0;
+    nearShadow=nullptr;
+    hNear=0;
+}
+
+// Resize the cache, keeping the entries used in their game's current generation. Must not be called during a search.
+//
+// An entry's new bucket is calculated from its board. Compact entries don't store the board, so when
+//  the cache grows their new bucket is unknown and they are dropped; when it shrinks the new bucket is
+//  the old bucket number with the high bits removed.
+void CCache::Resize(u64 nEntries) {
+    const u4 nNewBuckets=NBucketsFor(nEntries);
+    if (nNewBuckets==nBuckets)
+    	return;
+
+    CCacheBucket* const oldBuckets=buckets;
+    CBitBoard* const oldShadow=shadow;
+    const u4 nOldBuckets=nBuckets;
+    Allocate(nNewBuckets);
+    ClearEntries();
+
+    if (CCacheEntry::fStoresBoard || nBuckets<nOldBuckets) {
+    	for (u4 i=0; i<nOldBuckets; i++) {
+    		for (const CCacheEntry& entry : oldBuckets[i].entries) {
+    			CCacheData cd;
+    			entry.Read(cd);
+    			if (IsStale(cd))
+    				continue;
+    			const u64 hash=CCacheEntry::fStoresBoard ? cd.board.Hash() : i;
+    			CCacheEntry* victim=FindVictim(buckets[hash&(nBuckets-1)], cd.height, cd.iPrune, cd.nEmpty);
+    			if (victim) {
+    				victim->Copy(entry);
+    				if (shadow && oldShadow)
+    					SetShadow(*victim, oldShadow[&entry-oldBuckets->entries]);
+    			}
+    		}
+    	}
+    }
+
+    if (mapping) {
+    	UnmapFile(mapping, mappingSize);
+    	mapping=nullptr;
+    }
+    else
+    	LargeFree(oldBuckets, nOldBuckets*sizeof(CCacheBucket));
+    delete[] oldShadow;
+}
+
+/////////////////////////////////////////////////
+// Snapshots
+//
+// A snapshot file is a header padded to kSnapshotHeaderSize bytes, then the bucket array exactly as
+//  it is in memory, then the games' generations packed into a u64. Loading maps the file copy-on-write and uses the
+//  bucket array in place.
+/////////////////////////////////////////////////
+
+const size_t kSnapshotHeaderSize=4096;    // keeps the bucket array page-aligned in the mapping
+const char kSnapshotMagic[8]="NtestTT";
+const u4 kSnapshotVersion=2;
+
+struct CCacheSnapshotHeader {
+    char magic[8];
+    u4 version;
+    u4 entrySize;    // distinguishes full and compact entries
+    u4 nWays;
+    u4 nBuckets;
+};
+
+bool CCache::Save(const char* fnSnapshot) const {
+    CCacheSnapshotHeader header;
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version=kSnapshotVersion;
+    header.entrySize=sizeof(CCacheEntry);
+    header.nWays=CCacheBucket::nWays;
+    header.nBuckets=nBuckets;
+    char headerBlock[kSnapshotHeaderSize]={0};
+    memcpy(headerBlock, &header, sizeof(header));
+    u64 trailer=0;
+    for (int i=0; i<nGames; i++)
+    	trailer|=u64(generations[i])<<(16*i);
+
+    // Write to a temporary file and rename it: this cache may itself be a mapping of fnSnapshot,
+    // and truncating the file in place would pull the pages out from under it.
+    const std::string fnTemp=std::string(fnSnapshot)+".tmp";
+    FILE* fp=fopen(fnTemp.c_str(), "wb");
+    if (!fp)
+    	return false;
+    bool fOK=fwrite(headerBlock, sizeof(headerBlock), 1, fp)==1
+    	&& fwrite(buckets, sizeof(CCacheBucket), nBuckets, fp)==nBuckets
+    	&& fwrite(&trailer, sizeof(trailer), 1, fp)==1;
+    fOK=(fclose(fp)==0) && fOK;
+    if (fOK)
+    	fOK=rename(fnTemp.c_str(), fnSnapshot)==0;
+    if (!fOK)
+    	remove(fnTemp.c_str());
+    return fOK;
+}
+
+//! Load a cache from a snapshot written by Save().
+//! Throw string if the file can't be mapped or wasn't written by this version with this entry format
+CCache::CCache(const char* fnSnapshot) {
+    mapping=MapFile(fnSnapshot, mappingSize);
+    if (!mapping)
+    	throw std::string("can't map cache snapshot ")+fnSnapshot;
+
+    CCacheSnapshotHeader header;
+    memcpy(&header, mapping, std::min(sizeof(header), mappingSize));
+    if (mappingSize<kSnapshotHeaderSize || memcmp(header.magic, kSnapshotMagic, sizeof(header.magic))
+    	|| header.version!=kSnapshotVersion || header.entrySize!=sizeof(CCacheEntry) || header.nWays!=CCacheBucket::nWays
+    	|| header.nBuckets==0 || (header.nBuckets&(header.nBuckets-1))
+    	|| mappingSize!=kSnapshotHeaderSize+header.nBuckets*sizeof(CCacheBucket)+sizeof(u64)) {
+    	UnmapFile(mapping, mappingSize);
+    	throw std::string("incompatible cache snapshot ")+fnSnapshot;
     }
+
+    char* const base=reinterpret_cast<char*>(mapping);
+    nBuckets=header.nBuckets;
+    buckets=reinterpret_cast<CCacheBucket*>(base+kSnapshotHeaderSize);
+    u64 trailer;
+    memcpy(&trailer, base+kSnapshotHeaderSize+nBuckets*sizeof(CCacheBucket), sizeof(trailer));
+    for (int i=0; i<nGames; i++)
+    	generations[i]=u2(trailer>>(16*i));
+    pageMode=kNormalPages;
+    // stored boards aren't in the snapshot, so hits can't be verified
+    shadow=nullptr;
+    ClearStats();
+    fprintf(stderr, "Loaded cache with %llu entries from %s\n", static_cast<unsigned long long>(NEntries()), fnSnapshot);
 }
 
+// Start a new generation for the current game. Existing entries remain loadable but the game's
+//    entries become stale, and so are replaced first.
 void CCache::SetStale() {
-  staleCount += 1;
+    generations[iGame]++;
 }
 
 void CCache::PrintStats() const {
@@ -254,53 +470,126 @@ void CCache::ClearStats() {
     queries=readMoves=readValues=writes=0;
 }
 
-// FindOld -- find an entry in the cache. If there is no entry return NULL.
-//    If there is an entry set its stale flag to false and return it.
-CCacheData* CCache::FindOld(const CBitBoard& board, u64 hash) {
-    CCacheData *r1, *r2, *res;
+bool CCache::fVerifyHits=false;
+std::atomic<u64> CCache::nVerifiedHits(0), CCache::nFalseHits(0);
 
-    hash&=nBuckets-1;
-    r1=buckets+hash;
-    r2=buckets+(hash^1);
+void CCache::VerifyHits(bool fVerify) {
+    fVerifyHits=fVerify;
+    nVerifiedHits=nFalseHits=0;
+}
 
-    // is this position in cache?
-    res = nullptr;
-    if (r1->board==board) res = r1;
-    if (r2->board==board) res = r2;
-    if (res) res->SetStale(staleCount);
+void CCache::PrintHitStats() {
+    const u64 nHits=nVerifiedHits, nFalse=nFalseHits;
+    printf("Cache hits: %llu, false hits: %llu (%.3g per million hits)\n",
+    	static_cast<unsigned long long>(nHits), static_cast<unsigned long long>(nFalse), nHits ? nFalse*1e6/nHits : 0.);
+}
+
+static_assert(CCache::nTiers==nCacheTiers, "NodeStats needs a counter for each cache tier");
 
-    return res;
+void CCache::ClearTierStats() {
+    WipeNodeStats();
+    for (int i=0; i<nTiers; i++)
+    	nTierProbes[i]=nTierHits[i]=0;
 }
 
-// FindNew -- find an entry in the cache. If there is no entry create one, with height and iPrune preset.
-//    Return the cache entry.
-CCacheData* CCache::FindNew(const CBitBoard& board, u64 hash, int height, int aPrune, int anEmpty) {
-    CCacheData* result, *result2;
+void CCache::PrintTierStats() {
+    WipeNodeStats();
+    const char* const names[nTiers]={"main", "near"};
+    for (int i=0; i<nTiers; i++) {
+    	printf("%s tier: %.0f probes, %.0f hits (%.1f%%)\n", names[i], nTierProbes[i], nTierHits[i],
+    		nTierProbes[i] ? nTierHits[i]*100/nTierProbes[i] : 0.);
+    }
+}
 
-    hash&=nBuckets-1;
-    result=buckets+hash;
-    result2=buckets+(hash^1);
+// The shadow board for an entry in either tier, or NULL if hits aren't being verified
+CBitBoard* CCache::Shadow(const CCacheEntry& entry) const {
+    if (nearBuckets && &entry>=nearBuckets->entries && &entry<nearBuckets[nNearBuckets].entries)
+    	return nearShadow ? nearShadow+(&entry-nearBuckets->entries) : nullptr;
+    return shadow ? shadow+(&entry-buckets->entries) : nullptr;
+}
 
-    // is this position in cache?
-    if (result->board==board) {
-    	result->SetStale(staleCount);
+void CCache::SetShadow(const CCacheEntry& entry, const CBitBoard& board) {
+    if (CBitBoard* const p=Shadow(entry))
+    	*p=board;
+}
+
+void CCache::CheckHit(const CCacheEntry& entry, const CBitBoard& board) {
+    if (const CBitBoard* const p=Shadow(entry)) {
+    	nVerifiedHits++;
+    	if (*p!=board)
+    		nFalseHits++;
     }
-    else if (result2->board==board) {
-    	result=result2;
-    	result->SetStale(staleCount);
+}
+
+// FindOld -- find an entry in the cache. If there is no entry return false.
+//    If there is an entry mark it as used in this generation and copy it to cd.
+//    height is the height the position is to be searched to, which selects the tier.
+bool CCache::FindOld(const CBitBoard& board, u64 hash, int height, CCacheData& cd) {
+    const int tier=Tier(height);
+    CCacheBucket& bucket=Bucket(hash, height);
+    const CCacheEntry::TKey key=CCacheEntry::Key(board);
+
+    nTierProbesQuick[tier]++;
+    for (CCacheEntry& entry : bucket.entries) {
+    	if (entry.Read(key, board, cd)) {
+    		nTierHitsQuick[tier]++;
+    		CheckHit(entry, board);
+    		// write back only if the owner or generation changes, to avoid writes on most lookups
+    		if (cd.Game()!=iGame || cd.isStale(generations[iGame])) {
+    			Touch(cd);
+    			entry.Write(cd);
+    		}
+    		return true;
+    	}
     }
+    return false;
+}
 
-    // This position isn't the one in the cache...
-    else if (result->isStale(staleCount) || result->Replaceable(height, aPrune, anEmpty)) {
-    	result->Initialize(board, height, aPrune, anEmpty);
+// Find the entry to replace with a new position: the lowest-priority entry in the bucket that is
+//    either stale or less important than the new position. Return NULL if there is none.
+CCacheEntry* CCache::FindVictim(CCacheBucket& bucket, int height, int aPrune, int anEmpty) {
+    CCacheEntry* result=0;
+    int resultPriority=0;
+
+    for (CCacheEntry& entry : bucket.entries) {
+    	CCacheData cd;
+    	entry.Read(cd);
+    	if (IsStale(cd) || cd.Replaceable(height, aPrune, anEmpty)) {
+    		const int priority=Priority(cd);
+    		if (!result || priority<resultPriority) {
+    			result=&entry;
+    			resultPriority=priority;
+    		}
+    	}
     }
-    else if (result2->isStale(staleCount) || result2->Replaceable(height, aPrune, anEmpty)) {
-    	result=result2;
-    	result->Initialize(board, height, aPrune, anEmpty);
+    return result;
+}
+
+// FindNew -- find an entry in the cache. If there is no entry create one, with height and iPrune preset.
+//    Copies the entry to cd and returns where to write it back, or NULL if the position can't be stored.
+CCacheEntry* CCache::FindNew(const CBitBoard& board, u64 hash, int height, int aPrune, int anEmpty, CCacheData& cd) {
+    CCacheBucket& bucket=Bucket(hash, height);
+    const CCacheEntry::TKey key=CCacheEntry::Key(board);
+    CCacheEntry* result;
+
+    // is this position in cache?
+    for (CCacheEntry& entry : bucket.entries) {
+    	if (entry.Read(key, board, cd)) {
+    		CheckHit(entry, board);
+    		Touch(cd);
+    		result=&entry;
+    		UPDATE_CACHE_STATS;
+    		return result;
+    	}
     }
 
-    else
-    	result=0;
+    // This position isn't in the cache...
+    result=FindVictim(bucket, height, aPrune, anEmpty);
+    if (result) {
+    	cd.Initialize(board, height, aPrune, anEmpty);
+    	Touch(cd);
+    	SetShadow(*result, board);
+    }
 
     UPDATE_CACHE_STATS;
 
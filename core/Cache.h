@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include "BitBoard.h"
 #include "Moves.h"
 #include "port.h"
@@ -25,7 +29,8 @@ public:
     static int Importance(int aheight, int aPrune, int nEmpty);
 
     // misc
-    void SetStale(u1 count) {iCount = count;}
+    void SetGeneration(int aGame, u2 aGeneration) {game = aGame; generation = aGeneration;}
+    int Game() const { return game; }
     void Verify();
 
     // info
@@ -40,12 +45,15 @@ public:
     void Store(int height, int iPrune, int nEmpty, CMove bestMove, int iFastestFirst, CValue searchAlpha, CValue searchBeta, CValue& value);
 
     // debugging
-    void Print(bool fBlackMove, u1 count) const;
+    void Print(bool fBlackMove, u2 aGeneration) const;
     std::ostream& OutData(std::ostream& os) const;
 
     bool operator<(const CCacheData& b) const;
 
-  bool isStale(u1 count) const { return iCount != count; }
+    // aging. An entry is stale if it hasn't been used since its game's generation was last incremented.
+    bool isStale(u2 aGeneration) const { return generation != aGeneration; }
+    int Age(u2 aGeneration) const { return u2(aGeneration-generation); }
+    int Priority(u2 aGeneration) const;
 
 private:
     CBitBoard board;
@@ -54,10 +62,12 @@ private:
 
     CMove bestMove;
     u1 iFastestFirst;
-    u1 iCount;
-    /* all of the above should be implicitly set to 0 by calloc */
+    u1 game;    // the game that last used the entry; its generation is counted in that game's searches
+    u2 generation;
 
     friend class CCache;
+    friend class CCacheEntryFull;
+    friend class CCacheEntryCompact;
 };
 
 inline CCacheData::CCacheData() {};
@@ -66,19 +76,220 @@ inline bool CCacheData::operator<(const CCacheData& b) const { return board<b.bo
 inline std::ostream& operator<<(std::ostream& os, const CCacheData& cd) { return cd.OutData(os);}
 inline const CBitBoard& CCacheData::Board() const { return board; }
 
+// If nonzero, the cache stores 16-byte entries holding a 32-bit hash signature instead of the board.
+// This doubles the number of entries per MB but positions with the same signature collide.
+#ifndef CACHE_COMPACT_ENTRIES
+#define CACHE_COMPACT_ENTRIES 0
+#endif
+
+//! A CCacheData as stored in the CCache, including the full board.
+//!
+//! Each word of the board is stored XORed with both data words. Threads read and write
+//! entries without locks; an entry torn by simultaneous writes no longer matches its board
+//! and so is treated as a miss.
+class CCacheEntryFull {
+public:
+    //! What the entry stores to identify its position
+    typedef CBitBoard TKey;
+    static TKey Key(const CBitBoard& board) { return board; }
+    static const bool fStoresBoard=true;
+
+    //! If the entry holds the position with this key, copy it to cd and return true.
+    bool Read(const TKey& key, const CBitBoard& board, CCacheData& cd) const;
+    //! Copy the entry to cd. The board is only meaningful if the entry wasn't torn.
+    void Read(CCacheData& cd) const;
+    void Write(const CCacheData& cd);
+    void Copy(const CCacheEntryFull& entry);
+
+private:
+    // the data other than the board, packed into two words
+    static void Pack(const CCacheData& cd, u64& d0, u64& d1);
+    static void Unpack(u64 d0, u64 d1, CCacheData& cd);
+
+    std::atomic<u64> check[2];
+    std::atomic<u64> data[2];
+};
+
+inline void CCacheEntryFull::Pack(const CCacheData& cd, u64& d0, u64& d1) {
+    d0=u64(u4(cd.lBound)) | u64(u4(cd.uBound))<<32;
+    d1=u64(cd.height) | u64(cd.iPrune)<<8 | u64(cd.nEmpty)<<16 | u64(u1(cd.bestMove.Square()))<<24
+        | u64(cd.iFastestFirst)<<32 | u64(cd.generation)<<40 | u64(cd.game)<<56;
+}
+
+inline void CCacheEntryFull::Unpack(u64 d0, u64 d1, CCacheData& cd) {
+    cd.lBound=CValue(u4(d0));
+    cd.uBound=CValue(u4(d0>>32));
+    cd.height=u1(d1);
+    cd.iPrune=u1(d1>>8);
+    cd.nEmpty=u1(d1>>16);
+    cd.bestMove.Set(u1(d1>>24));
+    cd.iFastestFirst=u1(d1>>32);
+    cd.generation=u2(d1>>40);
+    cd.game=u1(d1>>56)&1;
+}
+
+inline bool CCacheEntryFull::Read(const TKey& key, const CBitBoard& board, CCacheData& cd) const {
+    const u64 d0=data[0].load(std::memory_order_relaxed);
+    const u64 d1=data[1].load(std::memory_order_relaxed);
+    if ((check[0].load(std::memory_order_relaxed)^d0^d1)!=key.empty
+        || (check[1].load(std::memory_order_relaxed)^d0^d1)!=key.mover)
+        return false;
+    cd.board=board;
+    Unpack(d0, d1, cd);
+    return true;
+}
+
+inline void CCacheEntryFull::Read(CCacheData& cd) const {
+    const u64 d0=data[0].load(std::memory_order_relaxed);
+    const u64 d1=data[1].load(std::memory_order_relaxed);
+    cd.board.empty=check[0].load(std::memory_order_relaxed)^d0^d1;
+    cd.board.mover=check[1].load(std::memory_order_relaxed)^d0^d1;
+    Unpack(d0, d1, cd);
+}
+
+inline void CCacheEntryFull::Write(const CCacheData& cd) {
+    u64 d0, d1;
+    Pack(cd, d0, d1);
+    check[0].store(cd.board.empty^d0^d1, std::memory_order_relaxed);
+    check[1].store(cd.board.mover^d0^d1, std::memory_order_relaxed);
+    data[0].store(d0, std::memory_order_relaxed);
+    data[1].store(d1, std::memory_order_relaxed);
+}
+
+inline void CCacheEntryFull::Copy(const CCacheEntryFull& entry) {
+    for (int i=0; i<2; i++) {
+        check[i].store(entry.check[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        data[i].store(entry.data[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+//! A CCacheData as stored in the CCache, in 16 bytes.
+//!
+//! Instead of the board the entry stores a 32-bit signature, computed with a different hash from the
+//! one that selects the bucket. Bounds are stored as CValueCompact.
+//!
+//! The check word holds the signature, generation and iFastestFirst XORed with the data word and its
+//! halves swapped, so that an entry torn by simultaneous writes almost never matches a signature.
+class CCacheEntryCompact {
+public:
+    typedef u4 TKey;
+    static TKey Key(const CBitBoard& board) { return u4(hash_mover_empty(board.empty, board.mover)); }
+    static const bool fStoresBoard=false;
+
+    bool Read(const TKey& key, const CBitBoard& board, CCacheData& cd) const;
+    //! Copy the entry to cd, except for the board which the entry doesn't know.
+    void Read(CCacheData& cd) const;
+    void Write(const CCacheData& cd);
+    void Copy(const CCacheEntryCompact& entry);
+
+private:
+    static u64 Scramble(u64 d) { return d^(d<<32|d>>32); }
+    static void Unpack(u64 c, u64 d, CCacheData& cd);
+    static u2 PackBound(CValue bound);
+
+    std::atomic<u64> check;
+    std::atomic<u64> data;
+};
+
+inline bool CCacheEntryCompact::Read(const TKey& key, const CBitBoard& board, CCacheData& cd) const {
+    const u64 d=data.load(std::memory_order_relaxed);
+    const u64 c=check.load(std::memory_order_relaxed)^Scramble(d);
+    if (u4(c>>32)!=key)
+        return false;
+    cd.board=board;
+    Unpack(c, d, cd);
+    return true;
+}
+
+inline void CCacheEntryCompact::Read(CCacheData& cd) const {
+    const u64 d=data.load(std::memory_order_relaxed);
+    Unpack(check.load(std::memory_order_relaxed)^Scramble(d), d, cd);
+}
+
+inline void CCacheEntryCompact::Unpack(u64 c, u64 d, CCacheData& cd) {
+    cd.generation=u2(c>>16);
+    cd.iFastestFirst=u1(c>>8);
+    // masked because the check word of a torn entry is garbage
+    cd.game=u1(c)&1;
+    cd.lBound=CValueCompact(u2(d));
+    cd.uBound=CValueCompact(u2(d>>16));
+    cd.height=u1(d>>32);
+    cd.iPrune=u1(d>>40);
+    cd.nEmpty=u1(d>>48);
+    cd.bestMove.Set(u1(d>>56));
+}
+
+static_assert(kInfinity<=INT16_MAX, "cache bounds must fit in a CValueCompact");
+
+//! Bound narrowed to a CValueCompact. Search values are within +/-kInfinity, so clamping never changes one.
+inline u2 CCacheEntryCompact::PackBound(CValue bound) {
+    return u2(CValueCompact(std::max(-kInfinity, std::min(kInfinity, bound))));
+}
+
+inline void CCacheEntryCompact::Write(const CCacheData& cd) {
+    const u64 d=u64(PackBound(cd.lBound)) | u64(PackBound(cd.uBound))<<16 | u64(cd.height)<<32 | u64(cd.iPrune)<<40
+        | u64(cd.nEmpty)<<48 | u64(u1(cd.bestMove.Square()))<<56;
+    const u64 c=u64(Key(cd.board))<<32 | u64(cd.generation)<<16 | u64(cd.iFastestFirst)<<8 | cd.game;
+    check.store(c^Scramble(d), std::memory_order_relaxed);
+    data.store(d, std::memory_order_relaxed);
+}
+
+inline void CCacheEntryCompact::Copy(const CCacheEntryCompact& entry) {
+    check.store(entry.check.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    data.store(entry.data.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+#if CACHE_COMPACT_ENTRIES
+typedef CCacheEntryCompact CCacheEntry;
+#else
+typedef CCacheEntryFull CCacheEntry;
+#endif
+
+//! One cache line of CCacheEntry. A position may be stored in any entry of the bucket selected by its hash.
+class alignas(64) CCacheBucket {
+public:
+    enum { nWays=64/sizeof(CCacheEntry) };
+    CCacheEntry entries[nWays];
+};
+
 /////////////////////////////////////////////////
 // CCache class
 /////////////////////////////////////////////////
 
 //! A transposition table.
 //! For each position in the CCache we store data of type CCacheData.
+//!
+//! Any number of search threads may use the table at once. Lookups return a copy of the
+//! entry; to update it, modify the copy and write it back to the CCacheEntry returned by FindNew().
+//!
+//! Each search starts a new generation with SetStale(). Entries record the generation in which they
+//!  were last used; entries from older generations are replaced first, but deep entries survive a
+//!  few generations so they are still available in the next search.
+//!
+//! The two games of a synchro match share one table. Each game has its own generation count and
+//!  entries are tagged with the game that last used them, so one game's searches don't make the
+//!  other game's entries stale. Any game can read any entry; reading one takes ownership of it.
+//!
+//! Positions searched to less than NearHeight() are kept in a separate near-leaf tier, small enough to
+//!  stay in the CPU cache, so the many shallow probes neither miss to DRAM nor evict deep entries.
+//!  Lookups pass the height so they go to the tier the position would have been stored in.
 class CCache {
 public:
-    CCache(u4 nBuckets);
+    enum { kMainTier, kNearTier, nTiers };
+    enum { nGames=2 };
+
+    CCache(u64 nEntries);
+    explicit CCache(const char* fnSnapshot);
     ~CCache();
 
-    // copy a cache
-    int CopyData(const CCache& cache2);
+    void Resize(u64 nEntries);
+
+    // Select the game whose searches use the cache until the next call
+    void SetGame(int aGame) { assert(aGame>=0 && aGame<nGames); iGame=aGame; }
+    int Game() const { return iGame; }
+
+    // snapshots
+    bool Save(const char* fnSnapshot) const;
 
     // Other
     void SetStale();
@@ -87,19 +298,70 @@ public:
     void Clear();
     //void Verify();
 
-    void Prefetch(u64 hash) {
-    	hash &= nBuckets - 1;
-      prefetch(reinterpret_cast<const char *>(buckets + hash));
+    void Prefetch(u64 hash, int height) {
+      prefetch(reinterpret_cast<const char *>(&Bucket(hash, height)));
     }
 
-    CCacheData* FindOld(const CBitBoard& pos, u64 hash);
-    CCacheData* FindNew(const CBitBoard& pos, u64 hash, int height, int iPrune, int nEmpty);
+    bool FindOld(const CBitBoard& pos, u64 hash, int height, CCacheData& cd);
+    CCacheEntry* FindNew(const CBitBoard& pos, u64 hash, int height, int iPrune, int nEmpty, CCacheData& cd);
+
+    u4 NBuckets() const { return nBuckets; }
+    u64 NEntries() const { return u64(nBuckets)*CCacheBucket::nWays; }
+    static u4 NBucketsFor(u64 nEntries);
+    TPageMode PageMode() const { return pageMode; }
+
+    // near-leaf tier
+    void SetNearTier(u64 nNearEntries, int hNear);
+    int NearHeight() const { return hNear; }
+    u64 NNearEntries() const { return hNear ? u64(nNearBuckets)*CCacheBucket::nWays : 0; }
+
+    // Probe and hit counts of FindOld() in each tier, summed over all threads since the last ClearTierStats()
+    static void ClearTierStats();
+    static void PrintTierStats();
+
+    // False-hit measurement. Caches created while verification is on keep a copy of the board
+    //  stored in each entry and count hits where the stored board differs from the one looked up.
+    static void VerifyHits(bool fVerify);
+    static void PrintHitStats();
 
-    int NBuckets() { return nBuckets; }
 private:
+    // height 0 entries are endgame solves, which cost much more than a shallow search and stay in the main tier
+    int Tier(int height) const { return height>0 && height<hNear ? kNearTier : kMainTier; }
+
+    bool IsStale(const CCacheData& cd) const { return cd.isStale(generations[cd.game]); }
+    int Priority(const CCacheData& cd) const { return cd.Priority(generations[cd.game]); }
+    // mark the entry as used in the current game's current generation
+    void Touch(CCacheData& cd) const { cd.SetGeneration(iGame, generations[iGame]); }
+
+    CCacheBucket& Bucket(u64 hash, int height) const {
+    	return Tier(height)==kNearTier ? nearBuckets[hash&(nNearBuckets-1)] : buckets[hash&(nBuckets-1)];
+    }
+
+    void Allocate(u4 nBuckets);
+    void Free();
+    void FreeNearTier();
+    void ClearEntries();
+    static void ClearEntries(CCacheBucket* buckets, u4 nBuckets, u2 generation);
+    CCacheEntry* FindVictim(CCacheBucket& bucket, int height, int iPrune, int nEmpty);
+    CBitBoard* Shadow(const CCacheEntry& entry) const;
+    void SetShadow(const CCacheEntry& entry, const CBitBoard& board);
+    void CheckHit(const CCacheEntry& entry, const CBitBoard& board);
+
     i4 queries, readMoves, readValues, writes;
-    CCacheData* buckets;
+    CCacheBucket* buckets;
     u4 nBuckets;
-    u1 staleCount = 0;
+    TPageMode pageMode;
+    void* mapping = nullptr;    // snapshot file the buckets are mapped from, if any
+    size_t mappingSize = 0;
+    u2 generations[nGames] = {0, 0};
+    int iGame = 0;
+    CBitBoard* shadow = nullptr;    // board stored in each entry, if verifying hits
+    CCacheBucket* nearBuckets = nullptr;
+    u4 nNearBuckets = 0;
+    int hNear = 0;    // positions searched to less than this height go in the near tier
+    CBitBoard* nearShadow = nullptr;
+
+    static bool fVerifyHits;
+    static std::atomic<u64> nVerifiedHits, nFalseHits;
     friend class CPlayerWithCache;
 };
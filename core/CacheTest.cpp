@@ -0,0 +1,313 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Cache.h"
+#include "CacheTest.h"
+#include "CalcParams.h"
+#include "NodeStats.h"
+
+#include "../n64/test.h"
+
+static CBitBoard TestBoard(int i) {
+    CBitBoard board;
+    board.empty=~(u64(1)<<i);
+    board.mover=u64(1)<<i;
+    return board;
+}
+
+// Store a position in the cache. Return false if the cache had no room for it.
+static bool Store(CCache& cache, int i, int height) {
+    const CBitBoard board=TestBoard(i);
+    const int nEmpty=40;
+    CCacheData cd;
+    CCacheEntry* entry=cache.FindNew(board, board.Hash(), height, 0, nEmpty, cd);
+    if (!entry)
+        return false;
+    CValue value=i;
+    cd.Store(height, 0, nEmpty, CMove(19), 0, -kInfinity, kInfinity, value);
+    entry->Write(cd);
+    return true;
+}
+
+static bool Contains(CCache& cache, int i, int height=10) {
+    CCacheData cd;
+    const CBitBoard board=TestBoard(i);
+    return cache.FindOld(board, board.Hash(), height, cd);
+}
+
+// Write an entry and read it back; check that torn entries and other positions don't match.
+template<class TEntry> static void TestCacheEntry() {
+    const CBitBoard board=TestBoard(5);
+    const CBitBoard other=TestBoard(6);
+    CCacheData cd, cd2;
+    CValue value=-300;
+
+    cd.Initialize(board, 3, 1, 40);
+    cd.Store(3, 1, 40, CMove(19), 9, -kInfinity, kInfinity, value);
+    TEntry entry, entry2;
+    entry.Write(cd);
+    assertTrue(entry.Read(TEntry::Key(board), board, cd2));
+    assertFalse(entry.Read(TEntry::Key(other), other, cd2));
+    assertTrue(cd2.Board()==board);
+    CMove move;
+    int iFastestFirst;
+    CValue searchAlpha, searchBeta, loaded;
+    assertTrue(cd2.Load(3, 1, 40, -kInfinity, kInfinity, move, iFastestFirst, searchAlpha, searchBeta, loaded));
+    assertEquals(-300, loaded);
+    assertEquals(19, move.Square());
+    assertEquals(9, iFastestFirst);
+
+    // the same position with different data, torn with the first write
+    value=500;
+    cd.Initialize(board, 5, 0, 40);
+    cd.Store(5, 0, 40, CMove(20), 0, -kInfinity, kInfinity, value);
+    entry2.Write(cd);
+    const int nWords=sizeof(TEntry)/sizeof(u64);
+    u64* const words=reinterpret_cast<u64*>(&entry);
+    const u64* const words2=reinterpret_cast<const u64*>(&entry2);
+    for (int i=nWords/2; i<nWords; i++)
+        words[i]=words2[i];
+    assertFalse(entry.Read(TEntry::Key(board), board, cd2));
+}
+
+// A compact entry clamps bounds to +/-kInfinity rather than letting them wrap around in 16 bits.
+static void TestCacheCompactBounds() {
+    const CBitBoard board=TestBoard(5);
+    CCacheData cd, cd2;
+    CValue value=40000;
+
+    cd.Initialize(board, 3, 0, 40);
+    cd.Store(3, 0, 40, CMove(19), 0, -kInfinity, kInfinity, value);
+    CCacheEntryCompact entry;
+    entry.Write(cd);
+    assertTrue(entry.Read(CCacheEntryCompact::Key(board), board, cd2));
+    CMove move;
+    int iFastestFirst;
+    CValue searchAlpha, searchBeta, loaded;
+    assertTrue(cd2.Load(3, 0, 40, -kInfinity, kInfinity, move, iFastestFirst, searchAlpha, searchBeta, loaded));
+    assertEquals(kInfinity, loaded);
+}
+
+// The cache has one bucket, so this tests replacement within a bucket.
+static void TestCacheReplacement() {
+    const int nWays=CCacheBucket::nWays;
+    CCache cache(nWays);
+
+    // fill the bucket with deep entries and one shallow entry
+    int i;
+    for (i=0; i<nWays-1; i++)
+        assertTrue(Store(cache, i, 10));
+    assertTrue(Store(cache, i, 1));
+
+    // a new position replaces the shallow entry, not the deep ones
+    assertTrue(Store(cache, nWays, 2));
+    assertFalse(Contains(cache, nWays-1));
+    for (i=0; i<nWays-1; i++)
+        assertTrue(Contains(cache, i));
+
+    // with no stale or less important entries there is no room
+    assertFalse(Store(cache, nWays+1, 1));
+
+    // after a new generation the old entries are stale; the shallowest goes first
+    cache.SetStale();
+    assertTrue(Store(cache, nWays+1, 1));
+    assertFalse(Contains(cache, nWays));
+    for (i=0; i<nWays-1; i++)
+        assertTrue(Contains(cache, i));
+
+    // deep entries that go unused for many generations are eventually replaced
+    for (int generation=0; generation<10; generation++)
+        cache.SetStale();
+    assertTrue(Contains(cache, nWays+1));
+    assertTrue(Store(cache, nWays+2, 1));
+    assertTrue(Contains(cache, nWays+2));
+    assertTrue(Contains(cache, nWays+1));
+    assertFalse(Contains(cache, 0));
+}
+
+// Resizing keeps entries from the current generation
+static void TestCacheResize() {
+    CCache cache(16);
+    int i;
+    for (i=0; i<8; i++)
+        Store(cache, i, 5);
+    cache.SetStale();
+    for (i=8; i<16; i++)
+        Store(cache, i, 5);
+    // positions from the current generation that were stored
+    std::vector<int> live;
+    for (i=8; i<16; i++) {
+        if (Contains(cache, i))
+            live.push_back(i);
+    }
+    assertTrue(live.size()>=4);
+
+    // when the cache shrinks some of them are kept
+    cache.Resize(2*CCacheBucket::nWays);
+    assertEquals(2*CCacheBucket::nWays, cache.NEntries());
+    std::vector<int> kept;
+    for (int j : live) {
+        if (Contains(cache, j))
+            kept.push_back(j);
+    }
+    assertTrue(kept.size()>0);
+    for (i=0; i<8; i++)
+        assertFalse(Contains(cache, i));
+
+    // when it grows they are all kept, if the entries store the board
+    cache.Resize(1024);
+    assertEquals(1024, cache.NEntries());
+    if (CCacheEntry::fStoresBoard) {
+        for (int j : kept)
+            assertTrue(Contains(cache, j));
+    }
+}
+
+// Save a snapshot and load it
+static void TestCacheSnapshot() {
+    const char* fn="cache_snapshot_test.tmp";
+    CCache cache(64);
+    cache.SetStale();
+    for (int i=0; i<8; i++)
+        Store(cache, i, 5);
+    assertTrue(cache.Save(fn));
+
+    {
+        CCache loaded(fn);
+        assertEquals(64, loaded.NEntries());
+        for (int i=0; i<8; i++)
+            assertEquals(Contains(cache, i), Contains(loaded, i));
+        assertFalse(Contains(loaded, 8));
+
+        // entries stored in the loaded cache are not written to the file
+        Store(loaded, 8, 5);
+        assertTrue(Contains(loaded, 8));
+    }
+    {
+        CCache loaded(fn);
+        assertFalse(Contains(loaded, 8));
+    }
+
+    // the generations are restored, so a full bucket of current entries has no room
+    CCache full(CCacheBucket::nWays);
+    full.SetGame(1);
+    full.SetStale();
+    for (int i=0; i<CCacheBucket::nWays; i++)
+        assertTrue(Store(full, i, 10));
+    assertTrue(full.Save(fn));
+    {
+        CCache loaded(fn);
+        assertFalse(Store(loaded, CCacheBucket::nWays, 1));
+    }
+
+    // a snapshot of a different size is not accepted
+    FILE* fp=fopen(fn, "ab");
+    fputc(0, fp);
+    fclose(fp);
+    bool fThrew=false;
+    try {
+        CCache bad(fn);
+    }
+    catch(const std::string&) {
+        fThrew=true;
+    }
+    assertTrue(fThrew);
+    remove(fn);
+}
+
+// Both games of a synchro match share the cache without making each other's entries stale
+static void TestCacheGames() {
+    const int nWays=CCacheBucket::nWays;
+    CCache cache(nWays);
+
+    int i;
+    for (i=0; i<nWays; i++)
+        assertTrue(Store(cache, i, 5));
+
+    // a new search in game 1 can read game 0's entries but not replace them
+    cache.SetGame(1);
+    cache.SetStale();
+    assertTrue(Contains(cache, 0));
+    assertFalse(Store(cache, nWays, 1));
+
+    // game 1 took ownership of the entry it read, so it survives game 0's next search
+    cache.SetGame(0);
+    cache.SetStale();
+    for (i=0; i<nWays-1; i++)
+        assertTrue(Store(cache, nWays+i, 1));
+    assertTrue(Contains(cache, 0));
+    for (i=1; i<nWays; i++)
+        assertFalse(Contains(cache, i));
+}
+
+// Shallow positions go to the near tier and don't displace deep ones
+static void TestCacheNearTier() {
+    const int nWays=CCacheBucket::nWays;
+    CCache cache(nWays);
+    cache.SetNearTier(nWays, 3);
+    assertEquals(3, cache.NearHeight());
+    assertEquals(nWays, cache.NNearEntries());
+
+    int i;
+    for (i=0; i<nWays; i++)
+        assertTrue(Store(cache, i, 5));
+    cache.SetStale();
+
+    // without the near tier these would replace the stale deep entries
+    for (i=nWays; i<2*nWays; i++)
+        assertTrue(Store(cache, i, 2));
+    for (i=0; i<nWays; i++)
+        assertTrue(Contains(cache, i, 5));
+    assertTrue(Contains(cache, 2*nWays-1, 2));
+
+    // lookups go to the tier for their height
+    assertFalse(Contains(cache, 0, 2));
+    assertFalse(Contains(cache, 2*nWays-1, 5));
+
+    CCache::ClearTierStats();
+    Contains(cache, 0, 5);
+    Contains(cache, 2*nWays-1, 1);
+    Contains(cache, 0, 1);
+    WipeNodeStats();
+    assertEquals(1, nTierProbes[CCache::kMainTier]);
+    assertEquals(1, nTierHits[CCache::kMainTier]);
+    assertEquals(2, nTierProbes[CCache::kNearTier]);
+    assertEquals(1, nTierHits[CCache::kNearTier]);
+    CCache::ClearTierStats();
+
+    // removing the tier sends everything to the main table
+    cache.SetNearTier(0, 0);
+    assertEquals(0, cache.NNearEntries());
+    assertTrue(Contains(cache, 0, 1));
+}
+
+static void TestCacheSizing() {
+    assertEquals(512, ParseMemSize("512"));
+    assertEquals(3<<20, ParseMemSize("3M"));
+    assertEquals(u64(128)<<30, ParseMemSize("128g"));
+    assertEquals(0, ParseMemSize("12 MB"));
+    assertEquals(0, ParseMemSize(""));
+
+    assertEquals(1, CCache::NBucketsFor(0));
+    assertEquals(1, CCache::NBucketsFor(CCacheBucket::nWays*2-1));
+    assertEquals(2, CCache::NBucketsFor(CCacheBucket::nWays*2));
+    assertEquals(1<<20, CCache::NBucketsFor(u64(CCacheBucket::nWays)<<20));
+}
+
+void TestCache() {
+    TestCacheEntry<CCacheEntryFull>();
+    TestCacheEntry<CCacheEntryCompact>();
+    TestCacheCompactBounds();
+    TestCacheReplacement();
+    TestCacheResize();
+    TestCacheSnapshot();
+    TestCacheGames();
+    TestCacheNearTier();
+    TestCacheSizing();
+}
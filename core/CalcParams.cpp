@@ -4,9 +4,11 @@
 // GPLv3.txt and License.txt in the instructions subdirectory for details.
 
 #include <algorithm>
+#include <cctype>
 #include <cstdlib>
 #include <cmath>
 #include <iomanip>
+#include <iostream>
 #include <sstream>
 
 #include "options.h"
@@ -20,10 +22,74 @@ using namespace std;
 
 double tMatch;    // total time available for a match
 double dGHz;    //	double dGHz - Approx processor speed
-double tSetStale=0.17;    // time to SetStale() in seconds... so we don't lose on time
 
-// maximum memory for cache
-uint64_t maxCacheMem=2ULL<<30; // 2 GB
+// maximum memory for cache. The default gives 2^21 entries of 32 bytes.
+// Set it at startup with the NTEST_CACHE_BYTES environment variable; see InitCacheOptions().
+uint64_t maxCacheMem=64ULL<<20; // 64 MB
+
+// near-leaf cache tier: positions searched to less than hNearCache are stored in a separate table of
+//    nearCacheMem bytes. Set them with NTEST_CACHE_NEAR_HEIGHT and NTEST_CACHE_NEAR_BYTES; a height of 0
+//    disables the tier.
+int hNearCache=3;
+uint64_t nearCacheMem=1ULL<<20; // 1 MB
+
+// if not empty, the cache is loaded from this snapshot file when created and saved to it when the
+//    computer is deleted. Set it with the NTEST_CACHE_SNAPSHOT environment variable.
+std::string fnCacheSnapshot;
+
+//! Parse a memory size in bytes, optionally followed by K, M or G. Return 0 if the text is not a size.
+uint64_t ParseMemSize(const char* text) {
+    char* end;
+    uint64_t size=strtoull(text, &end, 10);
+    switch(toupper(*end)) {
+    case 'G':
+    	size<<=10;
+    	// fall through
+    case 'M':
+    	size<<=10;
+    	// fall through
+    case 'K':
+    	size<<=10;
+    	end++;
+    	break;
+    }
+    return (end==text || *end) ? 0 : size;
+}
+
+//! Set size from the environment variable, if it is set
+void InitMemSize(const char* name, uint64_t& size) {
+    const char* text=getenv(name);
+    if (text) {
+    	const uint64_t value=ParseMemSize(text);
+    	if (value)
+    		size=value;
+    	else
+    		cerr << "ignoring " << name << "=" << text << ": not a memory size\n";
+    }
+}
+
+//! Set the cache options from the NTEST_CACHE_BYTES, NTEST_CACHE_NEAR_BYTES, NTEST_CACHE_NEAR_HEIGHT
+//! and NTEST_CACHE_SNAPSHOT environment variables, if they are set
+void InitCacheOptions() {
+    InitMemSize("NTEST_CACHE_BYTES", maxCacheMem);
+    InitMemSize("NTEST_CACHE_NEAR_BYTES", nearCacheMem);
+    const char* text=getenv("NTEST_CACHE_NEAR_HEIGHT");
+    if (text)
+    	hNearCache=atoi(text);
+    text=getenv("NTEST_CACHE_SNAPSHOT");
+    if (text)
+    	fnCacheSnapshot=text;
+}
+
+//! Change the cache memory budget. Computers resize their caches to the new budget, keeping the live
+//! entries, when they start their next search.
+//!
+//! This is the hook for a front end that lets the user change the budget between moves. No front end in
+//! this tree has such a command, so only the tests call it; in the shipped binaries the budget is the
+//! one set at startup.
+void SetCacheMem(uint64_t bytes) {
+    maxCacheMem=bytes;
+}
 
 void SetMatchTime(double aMatchTime) {
     if (aMatchTime<=0)
@@ -320,9 +386,6 @@ bool CCalcParamsMatchTime::RoundOK(const CHeightInfo& hi, int nEmpty, double tEl
 double CCalcParamsMatchTime::TTypical(int nEmpty, double tRemaining) const {
     double t;
 
-    // subtract buffer for clearing cache
-    tRemaining-=nEmpty*tSetStale;
-
     if (tRemaining<=0)
     	t=2;
     else if (nEmpty>=24)
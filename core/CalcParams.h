@@ -17,11 +17,17 @@
 extern double tMatch;    // total time available for a match
 extern double dGHz;    // processor speed
 const double dNPS=400000;    // approx midgame nodes per second on a 1GHz machine
-extern double tSetStale;
 
 // maximum amount of memory to allocate to cache table.
 //    should be a bit less than the total RAM on the computer.
 extern uint64_t maxCacheMem;
+uint64_t ParseMemSize(const char* text);
+void InitMemSize(const char* name, uint64_t& size);
+extern int hNearCache;
+extern uint64_t nearCacheMem;
+extern std::string fnCacheSnapshot;
+void InitCacheOptions();
+void SetCacheMem(uint64_t bytes);
 
 void SetMatchTime(double atMatch);
 
@@ -13,35 +13,58 @@
 #include <iomanip>
 #include <sstream>
 #include <math.h>
+#include <mutex>
 #include "port.h"
 #include "../n64/utils.h"
 #include "NodeStats.h"
 
 using namespace std;
 
-u4 nEvalsQuick=0;
-extern u4 nSNodesQuick;
+thread_local u4 nEvalsQuick=0, nBBFlipsQuick=0;
 double nEvals=0, nSNodes=0, nINodes=0, nKFlips=0, nBBFlips=0;
+double nHashHits=0, nHashMisses=0;
+thread_local u4 nTierProbesQuick[nCacheTiers], nTierHitsQuick[nCacheTiers];
+double nTierProbes[nCacheTiers], nTierHits[nCacheTiers];
 
-bool abortRound;
+std::atomic<bool> abortRound;
 static double qtAbort;
 static double qtAbortBase;
 
+// protects the totals, which are updated from all search threads
+static std::mutex nodeStatsMutex;
+
+//! Add this thread's quick counters to the totals
 void WipeNodeStats() {
+    std::lock_guard<std::mutex> lock(nodeStatsMutex);
     nEvals+=nEvalsQuick;
     nEvalsQuick=0;
     nSNodes+=nSNodesQuick;
     nSNodesQuick=0;
+    nBBFlips+=nBBFlipsQuick;
+    nBBFlipsQuick=0;
+    nHashHits+=nHashHitsQuick;
+    nHashHitsQuick=0;
+    nHashMisses+=nHashMissesQuick;
+    nHashMissesQuick=0;
+    for (int i=0; i<nCacheTiers; i++) {
+    	nTierProbes[i]+=nTierProbesQuick[i];
+    	nTierProbesQuick[i]=0;
+    	nTierHits[i]+=nTierHitsQuick[i];
+    	nTierHitsQuick[i]=0;
+    }
 }
 
 void CNodeStats::Read() {
     WipeNodeStats();
 
+    std::lock_guard<std::mutex> lock(nodeStatsMutex);
     nSNodes=::nSNodes;
     nKFlips=::nKFlips;
     nBBFlips=::nBBFlips;
     nINodes=::nINodes;
     nEvals=::nEvals;
+    nHashHits=::nHashHits;
+    nHashMisses=::nHashMisses;
     time=GetTicks();
 }
 
@@ -117,6 +140,8 @@ CNodeStats CNodeStats::operator-(const  CNodeStats& b) const {
     result.nSNodes=nSNodes-b.nSNodes;
     result.nKFlips=nKFlips-b.nKFlips;
     result.nBBFlips=nBBFlips-b.nBBFlips;
+    result.nHashHits=nHashHits-b.nHashHits;
+    result.nHashMisses=nHashMisses-b.nHashMisses;
     result.time=time-b.time;
 
     return result;
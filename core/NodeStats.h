@@ -9,15 +9,27 @@
 
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include "../port.h"
 
-extern u4 nEvalsQuick, nSNodesQuick;
+// per-thread counters, added to the totals by WipeNodeStats()
+extern thread_local u4 nEvalsQuick, nSNodesQuick, nBBFlipsQuick;
 extern double nEvals, nSNodes, nINodes, nKFlips, nBBFlips;
 
+// lookups in the n64 solver's hash table, counted the same way
+extern thread_local u4 nHashHitsQuick, nHashMissesQuick;
+extern double nHashHits, nHashMisses;
+
+// FindOld() probes and hits in each CCache tier, counted the same way
+const int nCacheTiers=2;
+extern thread_local u4 nTierProbesQuick[nCacheTiers], nTierHitsQuick[nCacheTiers];
+extern double nTierProbes[nCacheTiers], nTierHits[nCacheTiers];
+
 class CNodeStats {
 public:
     double nINodes, nSNodes, nKFlips, nBBFlips, nEvals;
+    double nHashHits, nHashMisses;
 
     i8 time;
 
@@ -33,7 +45,7 @@ public:
 inline std::ostream& operator<<(std::ostream& os, const CNodeStats& ns) { ns.Out(os); return os; }
 
 // thinking on opponent's time
-extern bool abortRound;
+extern std::atomic<bool> abortRound;
 extern bool abortOnInput;
 
 void WipeNodeStats();
@@ -2,6 +2,7 @@
 
 #include "Moves.h"
 #include "QPositionTest.h"
+#include "CacheTest.h"
 
 inline void testCore() {
   void TestBitBoard();
@@ -10,4 +11,5 @@ inline void testCore() {
   TestQPosition();
   CMove::Test();
   CMoves::Test();
+  TestCache();
 }
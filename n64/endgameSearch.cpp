@@ -33,10 +33,11 @@ void EndgameSearch::constructEmpties(u64 mover, u64 enemy) {
 	(p-1)->next = 0;
 }
 
-void EndgameSearch::init(u64 mover, u64 enemy) {
+void EndgameSearch::init(u64 mover, u64 enemy, HashTable* hashTable) {
 	constructEmpties(mover, enemy);
-	hashTable.clear();
+	this->hashTable = hashTable ? hashTable : &solverHash();
 	useHash = true;
+	probCutT = 0;
 }
 
 void EndgameSearch::validate() {
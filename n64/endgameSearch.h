@@ -28,11 +28,18 @@ class EndgameSearch {
 public:
 	Empty start;
 	Empty emptyArray[32];
-	HashTable hashTable;
+	HashTable* hashTable;
 	bool useHash;
+	/**
+	* Confidence of probcuts, in standard deviations of the probe error, or 0 for an exact search
+	*/
+	double probCutT;
 
 public:
-	void init(u64 mover, u64 enemy);
+	/**
+	* @param hashTable the hash table to use, or 0 for solverHash()
+	*/
+	void init(u64 mover, u64 enemy, HashTable* hashTable = 0);
 	void validate();
 
 private:
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "hash.h"
 #include "port.h"
+#include "core/NodeStats.h"
 
 u64 hash(u64 a, u64 b) {
 	const u64 mix = 0xc6a4a7935bd1e995ULL;
@@ -15,14 +16,20 @@ u64 hash(u64 a, u64 b) {
 /**
 * Update min and max based on a search result.
 *
+* The best move is only updated if the score is above alpha; when every move fails low the move
+* found is no better than the others, and an earlier best move is more useful.
+*
 * Precondition:
 *  this->init() must have been called for the current position (only once per position, not each time store() is called)
 */
-void Hash::store(int alpha, int beta, int score) {
+void Hash::store(int alpha, int beta, int score, int move) {
 	if (score > alpha) {
 		if (score > min) {
 			min = score;
 		}
+		if (move >= 0) {
+			bestMove = short(move);
+		}
 	}
 	if (score < beta) {
 		if (score < max) {
@@ -39,44 +46,160 @@ std::string Hash::toString() {
 	return os.str();
 }
 
+thread_local u4 nHashHitsQuick = 0, nHashMissesQuick = 0;
+
+static u64 solverHashBytes = HashTable::defaultBytes;
+static std::atomic<bool> solverHashAllocated(false);
+
+static HashTable* newSolverHash() {
+	solverHashAllocated = true;
+	return new HashTable(solverHashBytes);
+}
+
+HashTable& solverHash() {
+	// allocated on the first call and kept until the program exits
+	static HashTable* const table = newSolverHash();
+	return *table;
+}
+
+void SetSolverHashBytes(u64 nBytes) {
+	solverHashBytes = nBytes;
+	if (solverHashAllocated) {
+		solverHash().resize(nBytes);
+	}
+}
+
+bool HashEntry::read(u64 mover, u64 enemy, Hash& hash, int& generation) const {
+	const u64 d = data.load(std::memory_order_relaxed);
+	if ((check[0].load(std::memory_order_relaxed)^d) != mover || (check[1].load(std::memory_order_relaxed)^d) != enemy) {
+		return false;
+	}
+	hash.mover = mover;
+	hash.enemy = enemy;
+	hash.min = i1(d);
+	hash.max = i1(d>>8);
+	hash.depth = u1(d>>16);
+	generation = u1(d>>24);
+	hash.bestMove = i1(d>>32);
+	return true;
+}
+
+void HashEntry::readAge(int& depth, int& generation) const {
+	const u64 d = data.load(std::memory_order_relaxed);
+	depth = u1(d>>16);
+	generation = u1(d>>24);
+}
+
+void HashEntry::write(const Hash& hash, int generation) {
+	const u64 d = u64(u1(hash.min)) | u64(u1(hash.max))<<8 | u64(u1(hash.depth))<<16 | u64(u1(generation))<<24 | u64(u1(hash.bestMove))<<32;
+	check[0].store(hash.mover^d, std::memory_order_relaxed);
+	check[1].store(hash.enemy^d, std::memory_order_relaxed);
+	data.store(d, std::memory_order_relaxed);
+}
+
+void HashEntry::copy(const HashEntry& entry) {
+	check[0].store(entry.check[0].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	check[1].store(entry.check[1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	data.store(entry.data.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
 /**
-* Clear the HashTable (clear all elements)
+* Store an impossible position (no discs) with depth 0, so the entry is replaced first
 */
-void HashTable::clear() {
-	for (int i=0; i<size; i++) {
-		hashes[i].clear();
-	}
+void HashEntry::clear() {
+	write(Hash(), 0);
+}
+
+HashTable::HashTable(u64 nBytes) : generation(0) {
+	allocate(nBytes);
+}
+
+HashTable::~HashTable() {
+	LargeFree(buckets, nBuckets*sizeof(Bucket));
 }
 
 /**
-* @return the hash for the board, if it exists; or whatever's currently in the hash slot, if it doesn't
+* Allocate the largest power-of-2 number of buckets that fits in nBytes (at least 1), and clear them
 */
-Hash* HashTable::hashLoc(u64 mover, u64 enemy) {
-	u64 key = (size-1) & hash(mover, enemy);
-	return hashes+key;
+void HashTable::allocate(u64 nBytes) {
+	nBuckets = 1;
+	while (nBuckets*2*sizeof(Bucket) <= nBytes) {
+		nBuckets *= 2;
+	}
+	TPageMode pageMode;
+	buckets = reinterpret_cast<Bucket*>(LargeAlloc(nBuckets*sizeof(Bucket), pageMode));
+	if (!buckets) {
+		throw std::string("unable to allocate solver hash table");
+	}
+	clear();
+}
+
+void HashTable::resize(u64 nBytes) {
+	LargeFree(buckets, nBuckets*sizeof(Bucket));
+	allocate(nBytes);
 }
 
 /**
-* @return the Hash for the board, if it exists; or NULL if there is no Hash for the board
+* Clear the HashTable (clear all elements)
 */
-Hash* HashTable::getHash(u64 mover, u64 enemy) {
-	Hash* entry = hashLoc(mover, enemy);
-	if (entry->mover == mover && entry->enemy==enemy) {
-		return entry;
-	} else {
-		return 0;
+void HashTable::clear() {
+	for (u64 i=0; i<nBuckets; i++) {
+		for (HashEntry& entry : buckets[i].entries) {
+			entry.clear();
+		}
 	}
 }
 
+HashTable::Bucket& HashTable::bucket(u64 mover, u64 enemy) const {
+	return buckets[(nBuckets-1) & hash(mover, enemy)];
+}
+
+bool HashTable::getHash(u64 mover, u64 enemy, Hash& hash) const {
+	int entryGeneration;
+	for (const HashEntry& entry : bucket(mover, enemy).entries) {
+		if (entry.read(mover, enemy, hash, entryGeneration)) {
+			nHashHitsQuick++;
+			return true;
+		}
+	}
+	nHashMissesQuick++;
+	return false;
+}
+
 /**
 * A search has been completed. Store the information in the hash.
 *
-* Currently overwrites existing hash entry regardless of depth.
+* If the position isn't in the hash it replaces the depth-preferred entry if that is shallower
+* or from an earlier search, and the depth-preferred entry moves to the other entry; otherwise
+* it replaces the other entry.
 */
-void HashTable::storeHash(u64 mover, u64 enemy, int alpha, int beta, int score) {
-	Hash* entry = hashLoc(mover, enemy);
-	if (entry->mover != mover ||entry->enemy != enemy) {
-		entry->init(mover, enemy);
+void HashTable::storeHash(u64 mover, u64 enemy, int alpha, int beta, int score, int move) {
+	Bucket& b = bucket(mover, enemy);
+	Hash hash;
+	int entryGeneration;
+	HashEntry* entry = 0;
+	for (HashEntry& e : b.entries) {
+		if (e.read(mover, enemy, hash, entryGeneration)) {
+			entry = &e;
+			break;
+		}
+	}
+	if (!entry) {
+		const int depth = bitCountInt(~(mover|enemy));
+		int depth0, generation0;
+		b.entries[0].readAge(depth0, generation0);
+		if (generation0 != generation) {
+			entry = b.entries;
+		}
+		else if (depth >= depth0) {
+			b.entries[1].copy(b.entries[0]);
+			entry = b.entries;
+		}
+		else {
+			entry = b.entries+1;
+		}
+		hash.init(mover, enemy, depth);
 	}
-	entry->store(alpha, beta, score);
+	hash.store(alpha, beta, score, move);
+	entry->write(hash, generation);
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include "port.h"
 
@@ -8,9 +9,13 @@ struct Hash {
 	short depth;
 	short min;
 	short max;
+	/**
+	* Square of the move that raised alpha or cut off when the position was last solved, or -1 if none did
+	*/
+	short bestMove;
 
 public:
-    Hash() : mover(0), enemy(0), depth(0), min(-64), max(64) {}
+    Hash() : mover(0), enemy(0), depth(0), min(-64), max(64), bestMove(-1) {}
 	/**
 	* Update score of a parent of this node.
 	*
@@ -25,11 +30,6 @@ public:
 		}
 	}
 
-	void clear() {
-		mover = 0;
-		enemy = 0;
-	}
-
 	bool isExact() {
 		return min == max;
 	}
@@ -37,30 +37,107 @@ public:
 	std::string toString();
 
 private:
-	void init(u64 mover, u64 enemy) {
+	void init(u64 mover, u64 enemy, int depth) {
 		this->mover = mover;
 		this->enemy = enemy;
+		this->depth = short(depth);
 		min = -64;
 		max = 64;
+		bestMove = -1;
 	}
 
-	void store(int alpha, int beta, int score);
+	void store(int alpha, int beta, int score, int move);
 
 	friend class HashTable;
 };
 
-class HashTable {
-	static const int lgSize = 6;
-	static const int size = 1<<lgSize;
-	Hash hashes[size];	
+/**
+* A Hash as stored in the HashTable.
+*
+* Both words of the position are stored XORed with the data word. Threads read and write entries
+* without locks; an entry torn by simultaneous writes no longer matches its position and so is a miss.
+*/
+class HashEntry {
+public:
+	bool read(u64 mover, u64 enemy, Hash& hash, int& generation) const;
+	void write(const Hash& hash, int generation);
+
+	/**
+	* Depth and generation of whatever is in the entry, for choosing which entry to replace
+	*/
+	void readAge(int& depth, int& generation) const;
+
+	void copy(const HashEntry& entry);
+	void clear();
+
+private:
+	std::atomic<u64> check[2];
+	std::atomic<u64> data;
+};
 
+/**
+* Endgame transposition table.
+*
+* Buckets hold two entries. The first is depth-preferred: it is only replaced by a position with at
+* least as many empties, or once it is left over from a previous search. The second always takes
+* whatever the first won't. Entries are exact bounds on the disc differential, so they stay valid
+* from one solve to the next; the table is only cleared when it is resized.
+*
+* Any number of search threads may use the table at once.
+*/
+class HashTable {
 public:
-	Hash* getHash(u64 mover, u64 enemy);
-	void storeHash(u64 mover, u64 enemy, int alpha, int beta, int score);
+	explicit HashTable(u64 nBytes = defaultBytes);
+	~HashTable();
+	HashTable(const HashTable&) = delete;
+	HashTable& operator=(const HashTable&) = delete;
+
+	/**
+	* Copy the Hash for the board to hash and return true, or return false if there is no Hash for the board
+	*/
+	bool getHash(u64 mover, u64 enemy, Hash& hash) const;
+	/**
+	* Store a search result. move is the square of the best move found, or -1 if there is none.
+	*/
+	void storeHash(u64 mover, u64 enemy, int alpha, int beta, int score, int move = -1);
 	void clear();
 
+	/**
+	* Start a new search. Entries from earlier searches remain usable but their depth no longer protects them.
+	*/
+	void newSearch() { generation = u1(generation+1); }
+
+	/**
+	* Resize the table to use at most nBytes, and clear it. Must not be called during a search.
+	*/
+	void resize(u64 nBytes);
+	u64 nEntries() const { return u64(nBuckets)*nWays; }
+
+	static const u64 defaultBytes = 4ULL<<20;
+
 private:
-	Hash* hashLoc(u64 mover, u64 enemy);
+	enum { nWays = 2 };
+	struct alignas(64) Bucket {
+		HashEntry entries[nWays];
+	};
+
+	Bucket& bucket(u64 mover, u64 enemy) const;
+	void allocate(u64 nBytes);
+
+	Bucket* buckets;
+	u64 nBuckets;
+	u1 generation;
 };
 
 u64 hash(u64 a, u64 b);
+
+/**
+* The hash table used by solveNValue(). It is allocated on first use, so programs that never solve don't pay for it.
+*/
+HashTable& solverHash();
+
+/**
+* Set the size of solverHash(). If the table has already been allocated it is resized, which clears it.
+* Must not be called during a search.
+*/
+void SetSolverHashBytes(u64 nBytes);
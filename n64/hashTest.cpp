@@ -2,6 +2,7 @@
 #include <sstream>
 #include "hash.h"
 #include "test.h"
+#include "core/NodeStats.h"
 
 static void testCollisions() {
 	int count[256];
@@ -30,57 +31,143 @@ static void testUpdateParent() {
 
 	u64 mover = 0x000000FFFF000000ULL;
 	u64 enemy = 0x0;
-	assertNull(hashTable.getHash(mover, enemy));
+	Hash hash;
+	assertFalse(hashTable.getHash(mover, enemy, hash));
 
 	// Set the hash to have only a min value.
 	// the hash has only a min value, so the parent value has only a max value.
 	// Since the parent value has no min value, we can't update the score.
 	hashTable.storeHash(mover, enemy, -1, 1, 12);
-	Hash* hash = hashTable.getHash(mover, enemy);
-	assertNotNull(hash);
+	assertTrue(hashTable.getHash(mover, enemy, hash));
 	int score = -13;
-	hash->updateParent(score);
+	hash.updateParent(score);
 	assertEquals(-13, score);
-	hash->clear();
+	hashTable.clear();
 
 	// Set the hash to have an exact value.
 	// Since the hash has an exact value, the parent has an exact value
 	// and we can update the parent score.
 	hashTable.storeHash(mover, enemy, -1, 1, 0);
-	hash = hashTable.getHash(mover, enemy);
-	assertNotNull(hash);
+	assertTrue(hashTable.getHash(mover, enemy, hash));
 	score = -1;
-	hash->updateParent(score);
+	hash.updateParent(score);
 	assertEquals(0, score);
 
 	score = 1;
-	hash->updateParent(score);
+	hash.updateParent(score);
 	assertEquals(1, score);
-	hash->clear();
+	hashTable.clear();
 
 	// Set the hash to have only a max value.
 	// Since the hash has a max value, the parent has a min value and we can update the score
 	hashTable.storeHash(mover, enemy, -1, 1, -5);
-	hash = hashTable.getHash(mover, enemy);
-	assertNotNull(hash);
+	assertTrue(hashTable.getHash(mover, enemy, hash));
 	score = -1;
-	hash->updateParent(score);
+	hash.updateParent(score);
 	assertEquals(5, score);
 
 	score = 6;
-	hash->updateParent(score);
+	hash.updateParent(score);
 	assertEquals(6, score);
-	hash->clear();
+	hashTable.clear();
 
 	// set the hash value twice. Score should be the higher of the two, even if it happened first
 	hashTable.storeHash(mover, enemy, -1, 1, -4);
 	hashTable.storeHash(mover, enemy, -1, 1, -3);
+	assertTrue(hashTable.getHash(mover, enemy, hash));
 	score = 0;
-	hash->updateParent(score);
+	hash.updateParent(score);
 	assertEquals(4, score);
 }
 
+/**
+* A position with nEmpty empties, or one more if i is nonzero; different i give different positions
+*/
+static u64 testMover(int nEmpty, int i) {
+	return (~0ULL << nEmpty) ^ (u64(i) << 60);
+}
+
+static bool contains(const HashTable& hashTable, u64 mover) {
+	Hash hash;
+	return hashTable.getHash(mover, 0, hash);
+}
+
+static void testReplacement() {
+	// one bucket
+	HashTable hashTable(1);
+	assertEquals(2, hashTable.nEntries());
+
+	// the shallower position goes in the second entry and doesn't displace the deeper one
+	hashTable.storeHash(testMover(20, 0), 0, -64, 64, 0);
+	hashTable.storeHash(testMover(10, 0), 0, -64, 64, 0);
+	hashTable.storeHash(testMover(12, 0), 0, -64, 64, 0);
+	assertTrue(contains(hashTable, testMover(20, 0)));
+	assertFalse(contains(hashTable, testMover(10, 0)));
+	assertTrue(contains(hashTable, testMover(12, 0)));
+
+	// a deeper position takes the first entry and the old one moves to the second
+	hashTable.storeHash(testMover(22, 0), 0, -64, 64, 0);
+	assertTrue(contains(hashTable, testMover(22, 0)));
+	assertTrue(contains(hashTable, testMover(20, 0)));
+	assertFalse(contains(hashTable, testMover(12, 0)));
+
+	// in a new search, deep positions from the old search no longer block the first entry
+	hashTable.newSearch();
+	hashTable.storeHash(testMover(10, 1), 0, -64, 64, 0);
+	assertTrue(contains(hashTable, testMover(10, 1)));
+	assertTrue(contains(hashTable, testMover(20, 0)));
+	assertFalse(contains(hashTable, testMover(22, 0)));
+}
+
+static void testBestMove() {
+	HashTable hashTable;
+	const u64 mover = testMover(20, 0);
+	Hash hash;
+
+	// no move is stored when all moves fail low
+	hashTable.storeHash(testMover(20, 1), 0, -1, 1, -5, 10);
+	assertTrue(hashTable.getHash(testMover(20, 1), 0, hash));
+	assertEquals(-1, hash.bestMove);
+
+	hashTable.storeHash(mover, 0, -1, 1, 4, 63);
+	assertTrue(hashTable.getHash(mover, 0, hash));
+	assertEquals(63, hash.bestMove);
+	assertEquals(20, hash.depth);
+
+	// a fail low doesn't replace the move that raised alpha
+	hashTable.storeHash(mover, 0, 5, 7, 4, 12);
+	assertTrue(hashTable.getHash(mover, 0, hash));
+	assertEquals(63, hash.bestMove);
+	assertTrue(hash.isExact());
+}
+
+static void testHitCounts() {
+	HashTable hashTable;
+	WipeNodeStats();
+	CNodeStats start, end;
+	start.Read();
+	hashTable.storeHash(testMover(20, 0), 0, -64, 64, 0);
+	contains(hashTable, testMover(20, 0));
+	contains(hashTable, testMover(20, 1));
+	contains(hashTable, testMover(20, 2));
+	end.Read();
+	assertEquals(1, (end-start).nHashHits);
+	assertEquals(2, (end-start).nHashMisses);
+}
+
+static void testSolverHashBytes() {
+	// resizes the table if it exists already, and otherwise sets the size it is allocated with
+	SetSolverHashBytes(1<<20);
+	assertEquals((1<<20)/64*2, solverHash().nEntries());
+	SetSolverHashBytes(HashTable::defaultBytes);
+	assertEquals(HashTable::defaultBytes/64*2, solverHash().nEntries());
+}
+
 void testHash() {
 	testCollisions();
 	testUpdateParent();
+	testReplacement();
+	testBestMove();
+	testHitCounts();
+	testSolverHashBytes();
 }
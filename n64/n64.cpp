@@ -34,9 +34,11 @@ void showUsage() {
 	std::cout << "command is one of:\n"
 		<< "generateFlipFunctions\n"
 		<< "generateSolverTestPositions <depth>\n"
-		<< "timeSolves <depth>\n"
-		<< "timeWld <depth>\n"
+		<< "timeSolves <depth> [threads]\n"
+		<< "timeWld <depth> [threads]\n"
 		<< "stats <depth>\n"
+		<< "timeSelective <depth> [t]\n"
+		<< "probeStats <depth>\n"
 		<< "timeMobility\n";
 }
 
@@ -65,7 +67,8 @@ int n64_main(int argc, char* argv[]) {
 		}
 		else {
 			const int depth = atoi(argv[2]);
-			timeSolves(1, depth, false);
+			const int nThreads = argc > 3 ? atoi(argv[3]) : 1;
+			timeSolves(1, depth, false, nThreads);
 		}
 	}
 	else if (!strcmp("timeWld", argv[1])) {
@@ -74,7 +77,8 @@ int n64_main(int argc, char* argv[]) {
 		}
 		else {
 			const int depth = atoi(argv[2]);
-			timeSolves(1, depth, true);
+			const int nThreads = argc > 3 ? atoi(argv[3]) : 1;
+			timeSolves(1, depth, true, nThreads);
 		}
 	}
 	else if (!strcmp("stats", argv[1])) {
@@ -87,6 +91,24 @@ int n64_main(int argc, char* argv[]) {
 		}
 		dumpCutoffs();
 	}
+	else if (!strcmp("timeSelective", argv[1])) {
+		if (argc < 3) {
+			showUsage();
+		}
+		else {
+			const int depth = atoi(argv[2]);
+			const double t = argc > 3 ? atof(argv[3]) : 1.5;
+			timeSelectiveSolves(depth, t);
+		}
+	}
+	else if (!strcmp("probeStats", argv[1])) {
+		if (argc < 3) {
+			showUsage();
+		}
+		else {
+			probeStats(atoi(argv[2]));
+		}
+	}
 	else if (!strcmp("timeMobility", argv[1])) {
 		extern void timeMobility();
 		timeMobility();
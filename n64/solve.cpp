@@ -1,7 +1,10 @@
+#include <cmath>
 #include "stdafx.h"
 #include "search.h"
+#include "SearchThreads.h"
+#include "Stable.hpp"
 
-u4 nSNodesQuick = 0;
+thread_local u4 nSNodesQuick = 0;
 
 #define NODE nSNodesQuick++
 
@@ -9,6 +12,9 @@ const bool collectCutoffStats = false;
 
 int etcStats[2] = {0,0};
 int etcRequests = 0;
+int etcCutoffs = 0;
+// number of stability cutoffs by number of empties
+int stabilityCutoffs[64];
 
 bool resultOk(int alpha, int beta, int expected, int actual) {
 	if (expected >= beta) {
@@ -113,104 +119,399 @@ int solve2(int alpha, int beta, u64 mover, u64 enemy, int sq1, int sq2) {
 	return finalScore(mover, enemy);
 }
 
-int solveNParity(int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search, bool hasPassed);
-
-static const u64 BOTTOM = 0xFFFFFFFFULL;
-static const u64 TOP = ~BOTTOM;
-static const u64 LEFT = 0xF0F0F0F0F0F0F0F0ULL;
-static const u64 RIGHT = ~LEFT;
-static const u64 TL = TOP & LEFT;
-static const u64 TR = TOP & RIGHT;
-static const u64 BL = BOTTOM & LEFT;
-static const u64 BR = BOTTOM & RIGHT;
-
-static const u64 parityMask[64] = {
-	BR, BR, BR, BR, BL, BL, BL, BL,
-	BR, BR, BR, BR, BL, BL, BL, BL,
-	BR, BR, BR, BR, BL, BL, BL, BL,
-	BR, BR, BR, BR, BL, BL, BL, BL,
-	TR, TR, TR, TR, TL, TL, TL, TL,
-	TR, TR, TR, TR, TL, TL, TL, TL,
-	TR, TR, TR, TR, TL, TL, TL, TL,
-	TR, TR, TR, TR, TL, TL, TL, TL,
-};
+/**
+* Squares adjacent, orthogonally or diagonally, to a square in bits
+*/
+inline u64 adjacent(u64 bits) {
+	const u64 notA = ~MaskA;
+	const u64 notH = ~MaskH;
+	const u64 horizontal = bits | ((bits<<1) & notA) | ((bits>>1) & notH);
+	return horizontal | (horizontal<<8) | (horizontal>>8);
+}
 
 /**
-* Remove the empty from the list of empty squares, calculate new mover and enemy bitboards, and continue the search
+* The connected region of empty squares that contains seed
 */
-int solveNFlipParity(int newAlpha, int newBeta, u64 oldMover, u64 oldEnemy, u64 flip, u64 parity, Empty* empty, EndgameSearch* search) {
-	NODE;
-	u64 mover = oldEnemy & ~ flip;
-	u64 enemy = oldMover | flip | mask(empty->sq);
-	int nEmpty = (int) bitCount(~(mover|enemy));
-	int score;
-	empty->remove();
-	if (nEmpty == 2) {
-		Empty* e1 = search->start.next;
-		score = solve2(newAlpha, newBeta, mover, enemy, e1->sq, e1->next->sq);
+inline u64 emptyRegion(u64 seed, u64 empty) {
+	u64 region = seed;
+	for (;;) {
+		const u64 grown = adjacent(region) & empty;
+		if (grown == region) {
+			return region;
+		}
+		region = grown;
 	}
-	else {
-		parity ^= parityMask[empty->sq];
-		score = solveNParity(newAlpha, newBeta, mover, enemy, parity, search, false);
+}
+
+/**
+* Empty squares that are in a region with an odd number of empty squares.
+*
+* A region is a set of empty squares connected orthogonally or diagonally. Moving into an odd region
+* first tends to leave the opponent to move into even regions, which usually gives the last move in them to us.
+*/
+u64 constructParity(u64 empty) {
+	u64 parity = 0;
+	while (empty) {
+		const u64 region = emptyRegion(empty & (0-empty), empty);
+		if (bitCount(region) & 1) {
+			parity |= region;
+		}
+		empty &= ~region;
 	}
-	empty->insert();
-	return score;
+	return parity;
+}
+
+/**
+* Parity after a move to sq.
+*
+* Only the region that contained sq changes. Usually the rest of it stays connected and its parity simply
+* flips; otherwise sq split it and the pieces are refilled.
+*
+* @param empty empty squares after the move
+*/
+inline u64 updateParity(u64 parity, u64 empty, int sq) {
+	parity &= ~mask(sq);
+	const u64 neighbors = adjacent(mask(sq)) & empty;
+	if (!neighbors) {
+		return parity;
+	}
+	const u64 region = emptyRegion(neighbors & (0-neighbors), empty);
+	if ((neighbors & ~region) == 0) {
+		return parity ^ region;
+	}
+	const u64 rest = emptyRegion(neighbors & ~region, empty);
+	parity &= ~(region|rest);
+	if (bitCount(region) & 1) {
+		parity |= region;
+	}
+	return parity | constructParity(rest);
+}
+
+/**
+* For testing: updateParity() is inline, so this gives the tests a copy they can link to.
+*/
+u64 parityAfterMove(u64 parity, u64 empty, int sq) {
+	return updateParity(parity, empty, sq);
+}
+
+/**
+* Enemy discs that can never be flipped limit the mover's score.
+*
+* @return true if that limit is at most alpha; score is then set to the limit.
+*/
+static bool stabilityCutsOff(int alpha, u64 mover, u64 enemy, int& score) {
+	// even if every enemy disc were stable the limit would be above alpha
+	if (64 - 2*bitCountInt(enemy) > alpha) {
+		return false;
+	}
+	const u64 empty = ~(mover|enemy);
+	const int limit = 64 - 2*bitCountInt(stable_discs(mover, enemy, empty) & enemy);
+	if (limit > alpha) {
+		return false;
+	}
+	if (collectCutoffStats) {
+		stabilityCutoffs[bitCountInt(empty)]++;
+	}
+	score = limit;
+	return true;
+}
+
+const int mobilityMinEmpties = 8;
+
+/**
+* Order the legal moves of a shallow search: squares with good parity first, and within each parity
+* corners, then other squares, then x-squares (the order of the Empty list).
+*
+* @return number of moves written to sqs
+*/
+inline int orderShallowMoves(int sqs[], u64 moves, u64 parity) {
+	int nMoves = 0;
+	const u64 byParity[2] = { moves & parity, moves & ~parity };
+	for (u64 group : byParity) {
+		const u64 byType[3] = { group & corners, group & other, group & xSquares };
+		for (u64 squares : byType) {
+			while (squares) {
+				sqs[nMoves++] = int(popLowBit(squares));
+			}
+		}
+	}
+	return nMoves;
+}
+
+/**
+* Write the empty squares to sqs, squares in odd regions first.
+*
+* Each group is in square order; the Empty list's corner-first ordering costs more than it saves this close to the end.
+*/
+inline void sortByParity(int sqs[], u64 empty, u64 parity) {
+	u64 odd = empty & parity;
+	u64 even = empty & ~parity;
+	while (odd) {
+		*sqs++ = int(popLowBit(odd));
+	}
+	while (even) {
+		*sqs++ = int(popLowBit(even));
+	}
+}
+
+/**
+* Move to sq and solve the remaining 2 empties; the caller has checked that flip is nonzero
+*/
+inline int solve3Move(int alpha, int beta, u64 mover, u64 enemy, u64 flip, int sq, int sq1, int sq2) {
+	NODE;
+	return -solve2(-beta, -alpha, enemy & ~flip, mover | flip | mask(sq), sq1, sq2);
 }
 
-int solveNParity(int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search, bool hasPassed) {
+/**
+* Solve a position with exactly 3 empty squares.
+*/
+int solve3(int alpha, int beta, u64 mover, u64 enemy, u64 parity, bool hasPassed) {
+	int stabilityScore;
+	if (3 >= stabilityMinEmpties && stabilityCutsOff(alpha, mover, enemy, stabilityScore)) {
+		return stabilityScore;
+	}
+
+	int sqs[3];
+	sortByParity(sqs, ~(mover|enemy), parity);
+	const int sq1 = sqs[0], sq2 = sqs[1], sq3 = sqs[2];
 
 	int score = -OTH_INFINITY;
+	u64 flip;
 
-	// search with good parity
-	for(Empty* empty = search->start.next; empty; empty  = empty -> next) {
-		if (bitSet(empty->sq, parity)) {
-			u64 flip = flips(empty->sq, mover, enemy);
-			if (flip) {
-				int childScore = -solveNFlipParity(-beta, -alpha, mover, enemy, flip, parity, empty, search);
-				if (childScore >= beta) {
-					return childScore;
-				}
-				else if (childScore > score) {
-					score = childScore;
-					if (score > alpha) {
-						alpha = score;
-					}
-				}
+	if ((flip = flips(sq1, mover, enemy))) {
+		score = solve3Move(alpha, beta, mover, enemy, flip, sq1, sq2, sq3);
+		if (score >= beta) {
+			return score;
+		}
+		if (score > alpha) {
+			alpha = score;
+		}
+	}
+
+	if ((flip = flips(sq2, mover, enemy))) {
+		const int childScore = solve3Move(alpha, beta, mover, enemy, flip, sq2, sq1, sq3);
+		if (childScore >= beta) {
+			return childScore;
+		}
+		if (childScore > score) {
+			score = childScore;
+			if (score > alpha) {
+				alpha = score;
 			}
 		}
 	}
 
-	// search with bad parity
-	for(Empty* empty = search->start.next; empty; empty  = empty -> next) {
-		if (bitClear(empty->sq, parity)) {
-			u64 flip = flips(empty->sq, mover, enemy);
-			if (flip) {
-				int childScore = -solveNFlipParity(-beta, -alpha, mover, enemy, flip, parity, empty, search);
-				if (childScore >= beta) {
-					return childScore;
-				}
-				else if (childScore > score) {
-					score = childScore;
-					if (score > alpha) {
-						alpha = score;
-					}
+	if ((flip = flips(sq3, mover, enemy))) {
+		const int childScore = solve3Move(alpha, beta, mover, enemy, flip, sq3, sq1, sq2);
+		if (childScore > score) {
+			score = childScore;
+		}
+	}
+
+	if (score == -OTH_INFINITY) {
+		if (hasPassed) {
+			return finalScore(mover, enemy);
+		}
+		return -solve3(-beta, -alpha, enemy, mover, parity, true);
+	}
+	return score;
+}
+
+/**
+* Solve a position with exactly 4 empty squares.
+*/
+int solve4(int alpha, int beta, u64 mover, u64 enemy, u64 parity, bool hasPassed) {
+	int stabilityScore;
+	if (4 >= stabilityMinEmpties && stabilityCutsOff(alpha, mover, enemy, stabilityScore)) {
+		return stabilityScore;
+	}
+
+	const u64 empty = ~(mover|enemy);
+	int sqs[4];
+	sortByParity(sqs, empty, parity);
+
+	int score = -OTH_INFINITY;
+	for (int i=0; i<4; i++) {
+		const int sq = sqs[i];
+		const u64 flip = flips(sq, mover, enemy);
+		if (flip) {
+			NODE;
+			const int childScore = -solve3(-beta, -alpha, enemy & ~flip, mover | flip | mask(sq), updateParity(parity, empty ^ mask(sq), sq), false);
+			if (childScore >= beta) {
+				return childScore;
+			}
+			if (childScore > score) {
+				score = childScore;
+				if (score > alpha) {
+					alpha = score;
 				}
 			}
 		}
 	}
 
-	if (score > -OTH_INFINITY) {
-		return score;
+	if (score == -OTH_INFINITY) {
+		if (hasPassed) {
+			return finalScore(mover, enemy);
+		}
+		return -solve4(-beta, -alpha, enemy, mover, parity, true);
+	}
+	return score;
+}
+
+/**
+* Solve a position with at least 5 empty squares, and fewer than mobilityMinEmpties, without the hash table
+*/
+int solveNParity(int alpha, int beta, u64 mover, u64 enemy, u64 parity, bool hasPassed) {
+	const int nEmpty = bitCountInt(~(mover|enemy));
+	int stabilityScore;
+	if (nEmpty >= stabilityMinEmpties && stabilityCutsOff(alpha, mover, enemy, stabilityScore)) {
+		return stabilityScore;
+	}
+
+	int sqs[mobilityMinEmpties];
+	const int nMoves = orderShallowMoves(sqs, mobility(mover, enemy), parity);
+	if (nMoves == 0) {
+		if (hasPassed) {
+			return finalScore(mover, enemy);
+		}
+		return -solveNParity(-beta, -alpha, enemy, mover, parity, true);
 	}
-	if (hasPassed) {
+
+	int score = -OTH_INFINITY;
+	for (int i=0; i<nMoves; i++) {
+		const int sq = sqs[i];
+		const u64 flip = flips(sq, mover, enemy);
+		NODE;
+		const u64 childMover = enemy & ~flip;
+		const u64 childEnemy = mover | flip | mask(sq);
+		const u64 childParity = updateParity(parity, ~(childMover|childEnemy), sq);
+		const int childScore = nEmpty == 5
+			? -solve4(-beta, -alpha, childMover, childEnemy, childParity, false)
+			: -solveNParity(-beta, -alpha, childMover, childEnemy, childParity, false);
+		if (childScore >= beta) {
+			return childScore;
+		}
+		if (childScore > score) {
+			score = childScore;
+			if (score > alpha) {
+				alpha = score;
+			}
+		}
+	}
+	return score;
+}
+
+/**
+* Solve a position with fewer than mobilityMinEmpties empty squares using the kernel for its number of empties
+*/
+int solveShallow(int alpha, int beta, u64 mover, u64 enemy, u64 parity) {
+	const u64 empty = ~(mover|enemy);
+	switch (bitCountInt(empty)) {
+	case 0:
 		return finalScore(mover, enemy);
+	case 1:
+		return solve1(mover, enemy, int(lowBitIndex(empty)));
+	case 2: {
+		int sqs[2];
+		sortByParity(sqs, empty, parity);
+		return solve2(alpha, beta, mover, enemy, sqs[0], sqs[1]);
+	}
+	case 3:
+		return solve3(alpha, beta, mover, enemy, parity, false);
+	case 4:
+		return solve4(alpha, beta, mover, enemy, parity, false);
+	default:
+		return solveNParity(alpha, beta, mover, enemy, parity, false);
 	}
-	return -solveNParity(-beta, -alpha, enemy, mover, parity, search, true);
 }
 
-const int mobilityMinEmpties = 8;
+// nodes with at least this many empties are split between search threads
+int parallelMinEmpties = 14;
 
-int solveMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search);
+// nodes with at least this many empties try a stability cutoff
+int stabilityMinEmpties = 4;
+
+static OrderingEval orderingEval = 0;
+static int orderingEvalMinEmpties = 64;
+
+void setOrderingEval(OrderingEval eval, int minEmpties) {
+	orderingEval = eval;
+	orderingEvalMinEmpties = minEmpties;
+}
+
+// nodes with at least this many empties try a probcut in selective searches
+int probCutMinEmpties = 12;
+// depth of the shallow search used by probcut
+int probCutDepth = 2;
+
+int probeValue(int alpha, int beta, u64 mover, u64 enemy, int depth) {
+	if (depth == 0) {
+		return orderingEval(mover, enemy);
+	}
+	u64 moves = mobility(mover, enemy);
+	if (!moves) {
+		if (!mobility(enemy, mover)) {
+			return finalScore(mover, enemy)*kStoneValue;
+		}
+		return -probeValue(-beta, -alpha, enemy, mover, depth);
+	}
+	int score = -OTH_INFINITY*kStoneValue;
+	while (moves) {
+		const int sq = popLowBit(moves);
+		const u64 flip = flips(sq, mover, enemy);
+		NODE;
+		const int childScore = -probeValue(-beta, -alpha, enemy & ~flip, mover | flip | mask(sq), depth-1);
+		if (childScore > score) {
+			score = childScore;
+			if (score >= beta) {
+				break;
+			}
+			if (score > alpha) {
+				alpha = score;
+			}
+		}
+	}
+	return score;
+}
+
+/**
+* Standard deviation, in discs, of the difference between probeValue() and the solved score.
+*
+* Fitted to probeStats output for the 12, 19 and 20 empty test positions with the J/A evaluator:
+* the error grows by about 0.57 discs per empty, and deeper probes start lower.
+*/
+static double probeSigma(int nEmpty, int depth) {
+	static const double sigma12[] = { 8.2, 6.8, 6.0, 5.6, 4.8 };
+	return sigma12[std::min(depth, 4)] + 0.57*(nEmpty-12);
+}
+
+/**
+* Multi-probcut test of a node
+*
+* @param t confidence in standard deviations of the probe error
+* @param score[out] alpha or beta, whichever the probe predicts the score is beyond
+* @return true if the node is cut off
+*/
+static bool probCut(int alpha, int beta, u64 mover, u64 enemy, double t, int& score) {
+	const double margin = t*probeSigma(bitCountInt(~(mover|enemy)), probCutDepth);
+	if (beta < 64) {
+		const int probeBeta = int(std::ceil((beta+margin)*kStoneValue));
+		if (probeValue(probeBeta-1, probeBeta, mover, enemy, probCutDepth) >= probeBeta) {
+			score = beta;
+			return true;
+		}
+	}
+	if (alpha > -64) {
+		const int probeAlpha = int(std::floor((alpha-margin)*kStoneValue));
+		if (probeValue(probeAlpha, probeAlpha+1, mover, enemy, probCutDepth) <= probeAlpha) {
+			score = alpha;
+			return true;
+		}
+	}
+	return false;
+}
+
+int solveMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, int hashMove, int& bestMove, EndgameSearch* search);
 int solveHashMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search, bool hasPassed);
 
 /**
@@ -223,9 +524,9 @@ int solveNFlipMobility(int newAlpha, int newBeta, u64 oldMover, u64 oldEnemy, u6
 	int nEmpty = (int) bitCount(~(mover|enemy));
 	int score;
 	empty->remove();
-	parity ^= parityMask[empty->sq];
+	parity = updateParity(parity, ~(mover|enemy), empty->sq);
 	if (nEmpty < mobilityMinEmpties) {
-		score = solveNParity(newAlpha, newBeta, mover, enemy, parity, search, false);
+		score = solveShallow(newAlpha, newBeta, mover, enemy, parity);
 	}
 	else {
 		score = solveHashMobility(newAlpha, newBeta, mover, enemy, parity, search, false);
@@ -234,21 +535,42 @@ int solveNFlipMobility(int newAlpha, int newBeta, u64 oldMover, u64 oldEnemy, u6
 	return score;
 }
 
-static int enemyPostMoveMobilityCount(int sq, u64 mover, u64 enemy) {
-	const u64 flip = flips(sq, mover, enemy);
-	enemy ^= flip;
-	mover ^= (flip | mask(sq));
-	u64 mob = mobility(enemy, mover);
+/**
+* @param childMover, childEnemy the position after the move
+*/
+static int enemyPostMoveMobilityCount(u64 childMover, u64 childEnemy) {
+	u64 mob = mobility(childMover, childEnemy);
 	u64 weightedMob = bitCount(mob)+bitCount(mob&corners);
 	return  int(weightedMob);
 }
 
 /**
+* Move ordering score of a move from the ordering eval of the position after it.
+*
+* One disc of eval is worth a little less than half a move of enemy mobility. The score is clamped
+* so that moves still sort below the hash move and cheap-child bonuses; the sign is reversed
+* because the eval is from the child's point of view.
+*/
+static int evalOrderingScore(int childEval) {
+	const int maxScore = (1<<13)-1;
+	return std::max(-maxScore, std::min(maxScore, -childEval));
+}
+
+/**
+* Look up a child position in the hash (enhanced transposition cutoff).
+*
+* @param alpha alpha from CHILD point of view
+* @param beta beta from CHILD point of view
+* @param etcScore[in,out] raised to the parent score implied by the child's upper bound, if that is higher
 * @return true if the position is in hash and would cause an immediate cutoff
 */
-static bool hashCutsOff(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search) {
-	Hash* hash = search->hashTable.getHash(mover, enemy);
-	bool result = hash && (hash->min >= beta || hash->max <= alpha || hash->isExact());
+static bool hashCutsOff(int alpha, int beta, u64 childMover, u64 childEnemy, int& etcScore, EndgameSearch* search) {
+	Hash hash;
+	bool result = search->hashTable->getHash(childMover, childEnemy, hash);
+	if (result) {
+		hash.updateParent(etcScore);
+		result = hash.min >= beta || hash.max <= alpha || hash.isExact();
+	}
 	if (collectCutoffStats) {
 		etcStats[result]++;
 	}
@@ -256,18 +578,35 @@ static bool hashCutsOff(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch
 }
 
 /**
-* Put the moves in order from best to worst, based on simple calculations and enemy mobility
+* Put the moves in order from best to worst, based on simple calculations and enemy mobility,
+* plus the ordering eval if there is one and the node has enough empties.
+*
+* The best move from the hash, if any, goes first, followed by moves to positions whose hash
+* entry would cut off immediately, since those cost almost nothing to search.
+*
+* If the children are hashed, their hash entries also give a lower bound on the score of this
+* node. If a child refutes the parent, orderMoves() stops early: the caller should return etcScore
+* rather than search the moves.
 *
 * To get the Empty of the move, call moveEmpty(moveScore).
 *
 * @param alpha alpha from CHILD point of view
 * @param beta beta from CHILD point of view
+* @param hashMove square of the best move stored in the hash, or -1
 * @param moveScores[out] holds score, see above.
+* @param etcScore[out] lower bound on this node's score from the children's hash entries, or -OTH_INFINITY
+* @param etcMove[out] square of the move giving etcScore
 * @return number of legal moves
 */
-inline int orderMoves(int moveScores[], int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search) {
+inline int orderMoves(int moveScores[], int alpha, int beta, u64 mover, u64 enemy, u64 parity, int hashMove, int& etcScore, int& etcMove, EndgameSearch* search) {
 	int nMoves = 0;
 	const u64 moverMobility = mobility(mover, enemy);
+	const int nEmpty = bitCountInt(~(mover|enemy));
+	// children are hashed if they have at least mobilityMinEmpties empties
+	const bool probeChildren = search->useHash && nEmpty > mobilityMinEmpties;
+	const bool useEval = orderingEval && nEmpty >= orderingEvalMinEmpties;
+	etcScore = -OTH_INFINITY;
+	etcMove = -1;
 	if (collectCutoffStats) {
 		etcRequests++;
 	}
@@ -276,9 +615,28 @@ inline int orderMoves(int moveScores[], int alpha, int beta, u64 mover, u64 enem
 		int sq = empty->sq;
 		if (bitSet(sq, moverMobility)) {
 			const int index = int(empty - search->emptyArray);
+			const u64 flip = flips(sq, mover, enemy);
+			const u64 childMover = enemy & ~flip;
+			const u64 childEnemy = mover | flip | mask(sq);
 
-			int score = -enemyPostMoveMobilityCount(sq, mover, enemy)<<8;
-			score+=hashCutsOff(alpha, beta, mover, enemy, search)<<15;
+			int score = -enemyPostMoveMobilityCount(childMover, childEnemy)<<8;
+			if (useEval) {
+				score += evalOrderingScore(orderingEval(childMover, childEnemy));
+			}
+			if (probeChildren) {
+				const int oldEtcScore = etcScore;
+				score+=hashCutsOff(alpha, beta, childMover, childEnemy, etcScore, search)<<15;
+				if (etcScore > oldEtcScore) {
+					etcMove = sq;
+					if (etcScore >= -alpha) {
+						if (collectCutoffStats) {
+							etcCutoffs++;
+						}
+						return nMoves;
+					}
+				}
+			}
+			score+=(sq==hashMove)<<16;
 			score+= bit(sq, corners)<<7;
 			score += bit(sq, parity)<<5;
 			score-= index;
@@ -295,6 +653,24 @@ inline Empty* moveEmpty(EndgameSearch* search, int moveScore) {
 	return search->emptyArray+index;
 }
 
+/**
+* For testing: the squares of the moves in the order orderMoves() searches them, with no hash move.
+*
+* @return the squares, or nothing if a child's hash entry refutes the position
+*/
+std::vector<int> orderedMoves(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search) {
+	int moveScores[32];
+	int etcScore, etcMove;
+	const int nMoves = orderMoves(moveScores, -beta, -alpha, mover, enemy, constructParity(~(mover|enemy)), -1, etcScore, etcMove, search);
+	std::vector<int> squares;
+	if (etcScore < beta) {
+		for (int i=0; i<nMoves; i++) {
+			squares.push_back(moveEmpty(search, moveScores[i])->sq);
+		}
+	}
+	return squares;
+}
+
 int cutoffs[64][64];
 
 void initCutoffs() {
@@ -302,6 +678,7 @@ void initCutoffs() {
 		for (int j=0; j<64; j++) {
 			cutoffs[i][j]=0;
 		}
+		stabilityCutoffs[i]=0;
 	}
 }
 
@@ -341,6 +718,14 @@ void dumpCutoffs() {
 		std::cout << "ETC stats:\n";
 		std::cout << "cutoff " << etcStats[1] << " out of " << total << " total moves checked, or " << etcStats[1]/(double)total*100 << "%\n";
 		std::cout << "cutoff " << etcStats[1] << " out of " << etcRequests << " calls to move sort, or " << etcStats[1]/(double)etcRequests*100 << "%\n";
+		std::cout << "stability cutoffs by empties:";
+		for (int empty=0; empty<64; empty++) {
+			if (stabilityCutoffs[empty]) {
+				std::cout << " " << empty << ":" << stabilityCutoffs[empty];
+			}
+		}
+		std::cout << "\n";
+		std::cout << "node cut off by a child's hash entry in " << etcCutoffs << " out of " << etcRequests << " calls to move sort, or " << etcCutoffs/(double)etcRequests*100 << "%\n";
 	}
 }
 
@@ -348,14 +733,120 @@ static void updateCutoffs(int index, u64 nEmpties) {
 	cutoffs[nEmpties][index]++;
 }
 
-inline int solveMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search) {
+int solveN(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search, bool hasPassed);
+
+/**
+* The remaining moves of a solveMobility node, solved by several threads.
+*
+* Each move is solved with its own EndgameSearch, sharing the parent's hash table.
+*/
+class SolveSplit : public CSplitPoint {
+public:
+	SolveSplit(int alpha, int beta, u64 mover, u64 enemy, int score, int bestMove, const int squares[], int nMoves, const EndgameSearch* search)
+		: CSplitPoint(nMoves), alpha(alpha), beta(beta), score(score), bestMove(bestMove), mover(mover), enemy(enemy), squares(squares), search(search) {
+	}
+
+	// shared between threads, protected by mutex
+	int alpha;
+	const int beta;
+	int score;
+	int bestMove;
+
+protected:
+	void SearchItem(int i) override;
+
+private:
+	const u64 mover;
+	const u64 enemy;
+	const int* const squares;
+	const EndgameSearch* const search;
+};
+
+void SolveSplit::SearchItem(int i) {
+	int childBeta;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (score >= beta) {
+			return;
+		}
+		childBeta = -alpha;
+	}
+
+	const int sq = squares[i];
+	const u64 flip = flips(sq, mover, enemy);
+	const u64 childMover = enemy & ~flip;
+	const u64 childEnemy = mover | flip | mask(sq);
+
+	EndgameSearch childSearch;
+	childSearch.init(childMover, childEnemy, search->hashTable);
+	childSearch.useHash = search->useHash;
+	childSearch.probCutT = search->probCutT;
+
+	NODE;
+	const int childScore = -solveN(-beta, childBeta, childMover, childEnemy, &childSearch, false);
+	if (SearchAborted()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (childScore > score) {
+		score = childScore;
+		bestMove = sq;
+		if (score >= beta) {
+			Cutoff();
+		}
+		else if (score > alpha) {
+			alpha = score;
+		}
+	}
+}
+
+/**
+* Young brothers wait: once the first move has been solved, idle threads help solve the rest.
+*
+* @param bestMove[in,out] best move so far, updated if a better one is found
+* @return score of the node, given the score of the moves solved so far
+*/
+static int solveSplit(int alpha, int beta, u64 mover, u64 enemy, int score, int& bestMove, const int moveScores[], int nMoves, EndgameSearch* search) {
+	int squares[32];
+	for (int i=0; i<nMoves; i++) {
+		squares[i] = moveEmpty(search, moveScores[i])->sq;
+	}
+	SolveSplit split(alpha, beta, mover, enemy, score, bestMove, squares, nMoves, search);
+	split.Search();
+	bestMove = split.bestMove;
+	return split.score;
+}
+
+/**
+* If the search is aborted (a split point above this node was cut off), returns at once with a
+* meaningless score. Callers must check SearchAborted() before using or storing the score.
+*
+* @param hashMove square of the best move stored in the hash, or -1
+* @param bestMove[out] square of the move with the highest score, or -1 if there are no legal moves
+*/
+inline int solveMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, int hashMove, int& bestMove, EndgameSearch* search) {
 	// move ordering
 	int moveScores[32];
-	int nMoves=orderMoves(moveScores, -beta, -alpha, mover, enemy, parity, search);
+	int etcScore;
+	int nMoves=orderMoves(moveScores, -beta, -alpha, mover, enemy, parity, hashMove, etcScore, bestMove, search);
+	if (etcScore >= beta) {
+		return etcScore;
+	}
+	const bool fCanSplit = bitCountInt(~(mover|enemy)) >= parallelMinEmpties;
 
 	int score = -OTH_INFINITY;
+	bestMove = -1;
 
 	for (int i=0; i<nMoves; i++) {
+		if (fCanSplit && i) {
+			if (SearchAborted()) {
+				return score;
+			}
+			if (i+1<nMoves && IdleSearchThread()) {
+				return solveSplit(alpha, beta, mover, enemy, score, bestMove, moveScores+i, nMoves-i, search);
+			}
+		}
 		Empty* empty = moveEmpty(search, moveScores[i]);
 
 		u64 flip = flips(empty->sq, mover, enemy);
@@ -367,10 +858,12 @@ inline int solveMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity,
 					updateCutoffs(i, nEmpty);
 				}
 				score = childScore; 
+				bestMove = empty->sq;
 				break;
 			}
 			else if (childScore > score) {
 				score = childScore;
+				bestMove = empty->sq;
 				if (score > alpha) {
 					alpha = score;
 				}
@@ -381,29 +874,52 @@ inline int solveMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity,
 }
 
 int solveHashMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, EndgameSearch* search, bool hasPassed) {
+	int stabilityScore;
+	if (bitCountInt(~(mover|enemy)) >= stabilityMinEmpties && stabilityCutsOff(alpha, mover, enemy, stabilityScore)) {
+		return stabilityScore;
+	}
+
 	// hash check. Could either return a value or narrow [alpha, beta].
 	const int originalAlpha = alpha;
 	const int originalBeta = beta;
+	int hashMove = -1;
 
 	if (search->useHash) {
-		Hash* hash = search->hashTable.getHash(mover, enemy);
-		if (hash) {
-			if (hash->min >= beta) {
-				return hash->min;
+		Hash hash;
+		if (search->hashTable->getHash(mover, enemy, hash)) {
+			hashMove = hash.bestMove;
+			if (hash.min >= beta) {
+				return hash.min;
+			}
+			if (hash.max <= alpha || hash.isExact()) {
+				return hash.max;
 			}
-			if (hash->max <= alpha || hash->isExact()) {
-				return hash->max;
+			if (hash.min >= alpha) {
+				alpha = hash.min;
 			}
-			if (hash->min >= alpha) {
-				alpha = hash->min;
+			if (hash.max <= beta) {
+				beta = hash.max;
 			}
-			if (hash->max <= beta) {
-				beta = hash->max;
+		}
+	}
+
+	if (search->probCutT && orderingEval && bitCountInt(~(mover|enemy)) >= probCutMinEmpties) {
+		int probCutScore;
+		if (probCut(alpha, beta, mover, enemy, search->probCutT, probCutScore)) {
+			if (SearchAborted()) {
+				return probCutScore;
 			}
+			search->hashTable->storeHash(mover, enemy, originalAlpha, originalBeta, probCutScore);
+			return probCutScore;
 		}
 	}
 
-	int score = solveMobility(alpha, beta, mover, enemy, parity, search);
+	int bestMove;
+	int score = solveMobility(alpha, beta, mover, enemy, parity, hashMove, bestMove, search);
+	if (SearchAborted()) {
+		// the moves were not all searched, so the score means nothing
+		return score;
+	}
 
 	if (score == -OTH_INFINITY) {
 		if (hasPassed) {
@@ -413,31 +929,46 @@ int solveHashMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, End
 			score = -solveHashMobility(-beta, -alpha, enemy, mover, parity, search, true);
 		}
 	}
+	if (SearchAborted()) {
+		// the hash outlives this search, so a partial score must not be stored as a bound
+		return score;
+	}
 	if (search->useHash) {
-		search->hashTable.storeHash(mover, enemy, originalAlpha, originalBeta, score);
+		search->hashTable->storeHash(mover, enemy, originalAlpha, originalBeta, score, bestMove);
 	}
 	return score;
 }
 
 
-u64 constructParity(u64 empty) {
-	u64 parity=0;
-
-	while (empty) {
-		const int sq = popLowBit(empty);
-		parity ^= parityMask[sq];
-	}
-	return parity;
-}
-
 int solveN(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search, bool hasPassed) {
 	u64 parity = constructParity(~(mover|enemy));
 	return solveHashMobility(alpha, beta, mover, enemy, parity, search, hasPassed);
 }
 
-int solveNValue(int alpha, int beta, u64 mover, u64 enemy) {
+/**
+* @param useHash false if the caller keeps solves of this position in its own table. Solves with fewer than
+*  mobilityMinEmpties empties only use the hash at the root, so then it is not used at all.
+*/
+int solveNValue(int alpha, int beta, u64 mover, u64 enemy, bool useHash) {
 	EndgameSearch search;
 	search.init(mover, enemy);
+	search.useHash = useHash;
 	int resultN = solveN(alpha, beta, mover, enemy, &search, false);
 	return resultN;
 }
+
+int solveNValueSelective(int alpha, int beta, u64 mover, u64 enemy, double t) {
+	// allocated on first use, so exact solvers don't pay for it
+	static HashTable selectiveHash;
+	// bounds found with one confidence don't hold with another
+	static double hashT = 0;
+	if (t != hashT) {
+		selectiveHash.clear();
+		hashT = t;
+	}
+
+	EndgameSearch search;
+	search.init(mover, enemy, &selectiveHash);
+	search.probCutT = t;
+	return solveN(alpha, beta, mover, enemy, &search, false);
+}
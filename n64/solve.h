@@ -1,12 +1,52 @@
 #include "port.h"
 #include "endgameSearch.h"
 
-int solveNValue(int alpha, int beta, u64 mover, u64 enemy);
+int solveNValue(int alpha, int beta, u64 mover, u64 enemy, bool useHash = true);
+
+// nodes with at least this many empties are split between search threads
+extern int parallelMinEmpties;
+
+// nodes with at least this many empties try a stability cutoff before searching
+extern int stabilityMinEmpties;
+
+/**
+* Solve, cutting off nodes that a shallow search predicts to be outside [alpha, beta] (multi-probcut).
+*
+* Nodes with at least probCutMinEmpties empties are searched probCutDepth ply with the ordering eval
+* (see setOrderingEval()). If the result is more than t standard deviations of the probe error above
+* beta or below alpha, the node is cut off. The result is the exact one with high probability; to be
+* sure of it, verify with solveNValue().
+*
+* Selective results are kept in their own hash table, apart from exact ones, which is cleared when t
+* changes. Only one thread may call this at a time; it splits the search between threads itself.
+* Without an ordering eval this is an exact solve.
+*
+* @param t confidence of the cutoffs, in standard deviations
+*/
+int solveNValueSelective(int alpha, int beta, u64 mover, u64 enemy, double t);
+extern int probCutMinEmpties;
+extern int probCutDepth;
+
+/**
+* Value of a shallow search using the ordering eval, in units of 1/kStoneValue discs
+*/
+int probeValue(int alpha, int beta, u64 mover, u64 enemy, int depth);
+
+/**
+* Heuristic value of a position to the player to move, in units of 1/kStoneValue discs
+*/
+typedef int (*OrderingEval)(u64 mover, u64 enemy);
+
+/**
+* Order moves by eval at nodes with at least minEmpties empties, rather than by mobility.
+* eval=0 turns this off. Must not be called during a search.
+*/
+void setOrderingEval(OrderingEval eval, int minEmpties);
 
 // testing
 bool resultOk(int alpha, int beta, int expected , int actual);
 
 // debugging and information
-extern u4 nSNodesQuick;
+extern thread_local u4 nSNodesQuick;
 void initCutoffs();
 void dumpCutoffs();
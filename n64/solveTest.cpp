@@ -1,8 +1,14 @@
+#include <cmath>
 #include "stdafx.h"
 #include "test.h"
+#include "core/NodeStats.h"
+#include "SearchThreads.h"
 
 int solve1(u64 mover, u64 enemy, int sq);
 int solve2(int alpha, int beta, u64 mover, u64 enemy, int sq1, int sq2);
+int solve3(int alpha, int beta, u64 mover, u64 enemy, u64 parity, bool hasPassed);
+int solve4(int alpha, int beta, u64 mover, u64 enemy, u64 parity, bool hasPassed);
+u64 constructParity(u64 empty);
 int solveN(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search, bool hasPassed);
 
 static void testSolve1Flip() {
@@ -135,6 +141,56 @@ void testSolve2() {
 	testSolve2Flip();
 }
 
+/**
+* Plain negamax over every empty square, to check the shallow solvers against
+*/
+static int referenceSolve(u64 mover, u64 enemy, bool hasPassed) {
+	int score = -64;
+	bool hasMove = false;
+	u64 empty = ~(mover|enemy);
+	while (empty) {
+		const int sq = popLowBit(empty);
+		const u64 flip = flips(sq, mover, enemy);
+		if (flip) {
+			hasMove = true;
+			const int childScore = -referenceSolve(enemy & ~flip, mover | flip | mask(sq), false);
+			if (childScore > score) {
+				score = childScore;
+			}
+		}
+	}
+	if (!hasMove) {
+		return hasPassed ? int(bitCount(mover)-bitCount(enemy)) : -referenceSolve(enemy, mover, true);
+	}
+	return score;
+}
+
+static void testSolve3And4() {
+	srand(0);
+
+	for (int i=0; i<1000; i++) {
+		for (int nEmpty = 3; nEmpty <= 4; nEmpty++) {
+			// random squares near each other, so that they form regions of varying sizes
+			u64 empty = 0;
+			const int base = rand()&63;
+			while (bitCountInt(empty) < nEmpty) {
+				empty |= mask((base + (rand()%20)) & 63);
+			}
+			const u64 mover = rand64() & ~empty;
+			const u64 enemy = ~(mover|empty);
+			const u64 parity = constructParity(empty);
+			const int expected = referenceSolve(mover, enemy, false);
+
+			const int alpha = (rand()%129) - 64;
+			const int beta = alpha + 1 + rand()%(64-alpha+1);
+			const int full = nEmpty==3 ? solve3(-64, 64, mover, enemy, parity, false) : solve4(-64, 64, mover, enemy, parity, false);
+			const int windowed = nEmpty==3 ? solve3(alpha, beta, mover, enemy, parity, false) : solve4(alpha, beta, mover, enemy, parity, false);
+			assertEquals(expected, full);
+			assertTrue(resultOk(alpha, beta, expected, windowed));
+		}
+	}
+}
+
 class SolveTest {
 public:
 	u64 mover;
@@ -176,6 +232,10 @@ public:
 	void solve(bool wldOnly) const {
 		const int alpha = wldOnly ? -1 : -64;
 		const int beta = wldOnly ? 1 : 64;
+		solve(alpha, beta);
+	}
+
+	void solve(int alpha, int beta) const {
 		int actual = solveResult(alpha, beta);
 		if (!resultOk(alpha, beta, expected, actual)) {
 			printBoard(mover, enemy);
@@ -219,6 +279,8 @@ static std::vector<SolveTest> getSolverTests(int depth, bool withResults) {
 void solveTests(const std::vector<SolveTest>& tests, bool wldOnly) {
 	for (u32 i=0; i<tests.size(); i++) {
 		tests.at(i).solve(wldOnly);
+		// the per-thread counters are only 32 bits
+		WipeNodeStats();
 	}
 }
 
@@ -228,54 +290,221 @@ static void testSolveJcw(int depth) {
 	solveTests(tests, true);
 }
 
-void timeSolves(int nIterations, int depth, bool wldOnly) {
+void timeSolves(int nIterations, int depth, bool wldOnly, int nThreads) {
 	std::vector<SolveTest> tests = getSolverTests(depth, true);
 
+	SetSearchThreads(nThreads);
 	tests.at(0).solve(wldOnly); // make sure code is loaded into memory
 
-	const clock_t start(clock());
+	// wall-clock time, since with several threads cpu time overstates the time taken
+	CNodeStats start, end;
+	start.Read();
 
 	for (int count = 0; count< nIterations; count++) {
 		solveTests(tests, wldOnly);
 	}
 
-	const clock_t end(clock());
-	const clock_t dt = end-start;
-	const double ds = dt/(double)CLOCKS_PER_SEC;
+	end.Read();
+	const CNodeStats delta = end-start;
+	const double ds = delta.Seconds();
+	const double nodes = delta.nSNodes;
 
 	std::cout << "Time solve: " <<  ds << "s"
-		<< " with " << eng(nSNodesQuick, 5) << " nodes"
-		<< " = " << eng(nSNodesQuick/ds) << "n/s"
-		<< " or " << eng(ds/nSNodesQuick) << "s/n"
-		<< std::endl;
+		<< " with " << eng(nodes, 5) << " nodes"
+		<< " = " << eng(nodes/ds) << "n/s"
+		<< " or " << eng(ds/nodes) << "s/n"
+		<< "; hash hits " << eng(delta.nHashHits) << " of " << eng(delta.nHashHits+delta.nHashMisses);
+	if (nThreads > 1) {
+		std::cout << " using " << nThreads << " threads";
+	}
+	std::cout << std::endl;
+	SetSearchThreads(1);
+}
+
+/**
+* Print the mean and standard deviation of the error of probeValue(), in discs, at each probe depth
+*/
+void probeStats(int depth) {
+	const std::vector<SolveTest> tests = getSolverTests(depth, true);
+	const int maxValue = 65*kStoneValue;
+	for (int probeDepth = 0; probeDepth <= 4; probeDepth++) {
+		double sum = 0, sum2 = 0;
+		for (const SolveTest& test : tests) {
+			const double error = probeValue(-maxValue, maxValue, test.mover, test.enemy, probeDepth)/double(kStoneValue) - test.expected;
+			sum += error;
+			sum2 += error*error;
+		}
+		const double mean = sum/tests.size();
+		std::cout << "probe depth " << probeDepth << ": mean error " << mean << ", sd " << sqrt(sum2/tests.size() - mean*mean) << "\n";
+	}
+}
+
+/**
+* Time selective solves of the test positions and count how many have the right result and the right sign
+*/
+void timeSelectiveSolves(int depth, double t) {
+	const std::vector<SolveTest> tests = getSolverTests(depth, true);
+	CNodeStats start, end;
+	start.Read();
+	int nExact = 0, nWld = 0;
+	for (const SolveTest& test : tests) {
+		const int result = solveNValueSelective(-64, 64, test.mover, test.enemy, t);
+		nExact += result == test.expected;
+		nWld += (result > 0) - (result < 0) == (test.expected > 0) - (test.expected < 0);
+		WipeNodeStats();
+	}
+	end.Read();
+	const CNodeStats delta = end-start;
+	std::cout << "Selective solve (t=" << t << "): " << delta.Seconds() << "s with " << eng(delta.nSNodes, 5) << " nodes; "
+		<< nExact << " of " << tests.size() << " exact, " << nWld << " right WLD" << std::endl;
+}
+
+/**
+* Solve the test positions with the parallel solver, splitting as low as possible so that splits happen
+*/
+static void testParallelSolve(int depth) {
+	const int parallelMinEmptiesSave = parallelMinEmpties;
+	parallelMinEmpties = 9;
+	SetSearchThreads(4);
+
+	std::vector<SolveTest> tests = getSolverTests(depth, true);
+	solveTests(tests, false);
+	solveTests(tests, true);
+
+	SetSearchThreads(1);
+	parallelMinEmpties = parallelMinEmptiesSave;
+}
+
+/**
+* Solve the test positions in parallel, then solve them and their children on one thread with the hash the
+* parallel solves left.
+*
+* Subtrees of a split point that is cut off are abandoned part way. If their partial scores were stored in
+* the hash as bounds, the single-threaded solves would pick them up and get wrong results.
+*/
+static void testParallelSolveHash(int depth) {
+	const int parallelMinEmptiesSave = parallelMinEmpties;
+	parallelMinEmpties = 9;
+
+	const std::vector<SolveTest> tests = getSolverTests(depth, true);
+	solverHash().clear();
+	SetSearchThreads(4);
+	for (const SolveTest& test : tests) {
+		// narrow windows on both sides of the result, so that split points get cut off. These only leave
+		// bounds in the hash, so the solves below have to search below the root again.
+		test.solve(std::max(-64, test.expected-10), std::max(-62, test.expected-4));
+		test.solve(std::min(62, test.expected+4), std::min(64, test.expected+10));
+		WipeNodeStats();
+	}
+
+	SetSearchThreads(1);
+	// Cutoffs are rare at this depth, so also abort whole solves. Nodes that can split then give up after
+	// their first move, as they would under a cut-off split point.
+	abortRound = true;
+	for (const SolveTest& test : tests) {
+		solveNValue(-64, 64, test.mover, test.enemy);
+	}
+	abortRound = false;
+	WipeNodeStats();
+
+	for (const SolveTest& test : tests) {
+		u64 moves = mobility(test.mover, test.enemy);
+		if (moves) {
+			int score = -64;
+			while (moves) {
+				const int sq = popLowBit(moves);
+				const u64 flip = flips(sq, test.mover, test.enemy);
+				score = std::max(score, -solveNValue(-64, 64, test.enemy & ~flip, test.mover | flip | mask(sq)));
+			}
+			assertEquals(test.expected, score);
+		}
+		test.solve(false);
+		WipeNodeStats();
+	}
+
+	parallelMinEmpties = parallelMinEmptiesSave;
 }
 
 extern u64 constructParity(u64 empties);
 
+u64 parityAfterMove(u64 parity, u64 empty, int sq);
+
+/**
+* Play out a game from (mover, enemy), always taking the lowest legal square, and check that the
+* incremental parity matches the parity constructed from scratch after every move.
+*/
+static void testUpdateParityGame(u64 mover, u64 enemy) {
+	u64 parity = constructParity(~(mover|enemy));
+	bool hasPassed = false;
+	for (;;) {
+		u64 moves = mobility(mover, enemy);
+		if (!moves) {
+			if (hasPassed) {
+				return;
+			}
+			hasPassed = true;
+			std::swap(mover, enemy);
+			continue;
+		}
+		hasPassed = false;
+		const int sq = popLowBit(moves);
+		const u64 flip = flips(sq, mover, enemy);
+		const u64 childMover = enemy & ~flip;
+		const u64 childEnemy = mover | flip | mask(sq);
+		mover = childMover;
+		enemy = childEnemy;
+		const u64 empty = ~(mover|enemy);
+		parity = parityAfterMove(parity, empty, sq);
+		assertHexEquals(constructParity(empty), parity);
+	}
+}
+
+void testUpdateParity() {
+	// from the start position, where moves split large regions
+	testUpdateParityGame(0x0000000810000000ULL, 0x0000001008000000ULL);
+	for (const SolveTest& test : getSolverTests(12, true)) {
+		testUpdateParityGame(test.mover, test.enemy);
+	}
+}
+
 void testConstructParity() {
-	assertHexEquals(0x0F0F0F0F, constructParity(1));
+	assertHexEquals(1, constructParity(1));
+	// separate regions
+	assertHexEquals(5, constructParity(5));
+	// one region, connected horizontally or diagonally
+	assertHexEquals(0, constructParity(3));
+	assertHexEquals(0, constructParity(0x201));
+	// regions don't wrap around the board edge
+	assertHexEquals(0x180, constructParity(0x180));
+	assertHexEquals(0x7ULL | mask(63), constructParity(0x7ULL | mask(63)));
 }
 
+std::vector<int> orderedMoves(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search);
+
+/**
+* A child whose hash entry cuts it off is searched before the others, since that only costs a probe (ETC)
+*/
 void testOrderMoves() {
-	//int orderMoves(int moveScores[], u64 mover, u64 enemy, u64 parity, Search* search);
-	//Empty*  moveEmpty(Search* search, int moveScore);
-
-	//// 4 empties. first quadrant: X-square and corner; second quadrant: x-square; third quadrant: corner with no mobility
-	//// should put them in order: 1st quadrant corner, 2nd quadrant x-square, 1st quadrant x-square
-	//// based on corner > parity > x-square
-	//const u64 empty = mask(000)|mask(011)|mask(016)|mask(061);
-	//const u64 enemy = empty << 8;
-	//const u64 mover = ~(enemy | empty);
-	//assertHexEquals(mask(000)|mask(011)|mask(016), mobility(mover, enemy));
-
-	//Search search;
-	//search.constructEmpties(mover, enemy);
-	//int moveScores[32];
-	//int nMoves = orderMoves(moveScores, mover, enemy, constructParity(empty), &search);
-	//assertEquals(3, nMoves);
-	//assertEquals(000, moveEmpty(&search, moveScores[0])->sq);
-	//assertEquals(016, moveEmpty(&search, moveScores[1])->sq);
-	//assertEquals(011, moveEmpty(&search, moveScores[2])->sq);
+	// a position with a few moves to order
+	const std::vector<SolveTest> tests = getSolverTests(12, true);
+	const SolveTest& test = *std::find_if(tests.begin(), tests.end(), [](const SolveTest& t) {
+		return bitCountInt(mobility(t.mover, t.enemy)) >= 4;
+	});
+	HashTable hashTable;
+	EndgameSearch search;
+	search.init(test.mover, test.enemy, &hashTable);
+
+	const std::vector<int> order = orderedMoves(0, 1, test.mover, test.enemy, &search);
+	assertTrue(order.size() >= 2);
+
+	// the last move's child is solved: the parent loses by 20 after it, which doesn't refute the parent
+	const int sq = order.back();
+	const u64 flip = flips(sq, test.mover, test.enemy);
+	hashTable.storeHash(test.enemy & ~flip, test.mover | flip | mask(sq), -64, 64, 20);
+
+	const std::vector<int> etcOrder = orderedMoves(0, 1, test.mover, test.enemy, &search);
+	assertEquals(order.size(), etcOrder.size());
+	assertEquals(sq, etcOrder.front());
 }
 
 void generateSolverTestPositions(int depth) {
@@ -287,6 +516,43 @@ void generateSolverTestPositions(int depth) {
 	}
 }
 
+/**
+* Solve with and without the stability cutoff, returning the value and counting nodes in nSNodesQuick
+*/
+static int solveStability(int alpha, int beta, const SolveTest& test, bool cutoff) {
+	const int stabilityMinEmptiesSave = stabilityMinEmpties;
+	if (!cutoff) {
+		stabilityMinEmpties = 64;
+	}
+	nSNodesQuick = 0;
+	const int result = solveNValue(alpha, beta, test.mover, test.enemy, false);
+	stabilityMinEmpties = stabilityMinEmptiesSave;
+	return result;
+}
+
+/**
+* The enemy's full north and west edges are 15 stable discs, so the mover can score at most 64-2*15 = 34
+*/
+static void testStabilityCutoff() {
+	std::istringstream in("bbbbbbbbbwwwwww.bwwbww..bwwwbw.wbwbwww..bwwbwww.bw.wwwb.b..wwwww -32");
+	const SolveTest test(in);
+	assertTrue(bitCountInt(~(test.mover|test.enemy)) >= stabilityMinEmpties);
+
+	// the cutoff doesn't change the value, but prunes nodes below the root
+	assertEquals(test.expected, solveStability(-64, 64, test, false));
+	const u4 nodes = nSNodesQuick;
+	assertEquals(test.expected, solveStability(-64, 64, test, true));
+	assertTrue(nSNodesQuick < nodes);
+
+	for (int alpha : {-40, -33, -32, -31, 0, 20, 33}) {
+		assertTrue(resultOk(alpha, alpha+1, test.expected, solveStability(alpha, alpha+1, test, true)));
+	}
+
+	// at the root, with alpha at the limit, no move is searched
+	assertEquals(34, solveStability(34, 64, test, true));
+	assertEquals(0, nSNodesQuick);
+}
+
 static void testResultOk() {
 	assertTrue(resultOk(-1, 1, -12, -2));
 }
@@ -295,10 +561,15 @@ void testSolve() {
 	getSolverTests(12, true).at(86).solve(false);
 
 	testConstructParity();
+	testUpdateParity();
 	testSolve1();
 	testSolve2();
+	testSolve3And4();
 	testSolveN();
 	testResultOk();
+	testStabilityCutoff();
 	testSolveJcw(12);
+	testParallelSolve(12);
+	testParallelSolveHash(12);
 	testOrderMoves();
 }
@@ -1,2 +1,4 @@
 void generateSolverTestPositions(int depth);
-void timeSolves(int nIterations, int depth, bool wldOnly);
+void timeSolves(int nIterations, int depth, bool wldOnly, int nThreads = 1);
+void timeSelectiveSolves(int depth, double t);
+void probeStats(int depth);
@@ -28,3 +28,6 @@ int nCapturedPositions=0;
 
 int hNegascout=6;
 
+// minimum height at which the search is split between threads
+int hSplit=4;
+
@@ -32,3 +32,4 @@ extern int nCapturedPositions;
 
 // search params
 extern int hNegascout;
+extern int hSplit;
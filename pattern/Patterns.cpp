@@ -28,6 +28,7 @@ u2 CRID10Reverse(u2 config);
 u2 R33Reverse(u2 config);
 u2 ORIDReverse(u2 config, int size);
 u4 row2To2x5[6561],row1To2x5[6561],row2ToXX[6561];
+uint64_t row2To2x5AndXX[6561];
 u4 row1ToTriangle[6561],row2ToTriangle[6561],row3ToTriangle[6561],row4ToTriangle[6561];
 u4 configs2x5To2x4[9*6561];
 
@@ -195,6 +196,7 @@ void InitTranslators() {
         int trits[8];
         ConfigToTrits(config, 8, trits);
         row2ToXX[config]=trits[1]+3*6561*trits[6];
+        row2To2x5AndXX[config]=row2To2x5[config] | uint64_t(row2ToXX[config])<<32;
     }
 
     // 2x5->2x4 translator
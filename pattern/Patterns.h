@@ -128,6 +128,8 @@ u4 TritsToRConfig(int* trits, int length);
 
 // using two row values to create a larger pattern
 extern u4 row2To2x5[6561],row1To2x5[6561],row2ToXX[6561];
+// row2To2x5 in the low 32 bits and row2ToXX in the high 32 bits, so the edge patterns take one lookup for row 2
+extern uint64_t row2To2x5AndXX[6561];
 extern u4 row1ToTriangle[6561],row2ToTriangle[6561],row3ToTriangle[6561],row4ToTriangle[6561];
 extern u4 configs2x5To2x4[9*6561];
 
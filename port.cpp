@@ -29,3 +29,131 @@ i8 GetTicksPerSecond(void) {
     return (i8) 1000000;
 }
 #endif // _WIN32
+
+#if defined(_WIN32)
+
+void* LargeAlloc(size_t size, TPageMode& mode) {
+    mode=kNormalPages;
+    return VirtualAlloc(NULL, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+}
+
+void LargeFree(void* p, size_t size) {
+    if (p)
+        VirtualFree(p, 0, MEM_RELEASE);
+}
+
+void* MapFile(const char* fn, size_t& size) {
+    HANDLE file=CreateFileA(fn, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file==INVALID_HANDLE_VALUE)
+        return NULL;
+    LARGE_INTEGER fileSize;
+    void* p=NULL;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart) {
+        HANDLE mapping=CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping) {
+            p=MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        size=size_t(fileSize.QuadPart);
+    }
+    CloseHandle(file);
+    return p;
+}
+
+void UnmapFile(void* p, size_t size) {
+    if (p)
+        UnmapViewOfFile(p);
+}
+
+#else
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const size_t hugePageSize=2<<20;
+
+static size_t HugePageRound(size_t size) {
+    return (size+hugePageSize-1)&~(hugePageSize-1);
+}
+
+// madvise(MADV_HUGEPAGE) succeeds even if transparent huge pages are switched off
+static bool TransparentHugePagesEnabled() {
+    char setting[100]="";
+    FILE* fp=fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!fp)
+        return false;
+    const bool fRead=fgets(setting, sizeof(setting), fp)!=NULL;
+    fclose(fp);
+    return fRead && !strstr(setting, "[never]");
+}
+
+//! Try, in order: explicitly reserved huge pages (MAP_HUGETLB), transparent huge pages, normal pages.
+void* LargeAlloc(size_t size, TPageMode& mode) {
+    const size_t rounded=HugePageRound(size);
+    void* p;
+
+#ifdef MAP_HUGETLB
+    p=mmap(NULL, rounded, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (p!=MAP_FAILED) {
+        mode=kHugePages;
+        return p;
+    }
+#endif
+
+    // Transparent huge pages need 2MB-aligned memory, so map extra and trim the ends.
+    p=mmap(NULL, rounded+hugePageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p==MAP_FAILED)
+        return NULL;
+    char* const start=reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p)+hugePageSize-1)&~(hugePageSize-1));
+    char* const end=start+rounded;
+    if (start!=p)
+        munmap(p, start-reinterpret_cast<char*>(p));
+    munmap(end, reinterpret_cast<char*>(p)+rounded+hugePageSize-end);
+
+    mode=kNormalPages;
+#ifdef MADV_HUGEPAGE
+    if (madvise(start, rounded, MADV_HUGEPAGE)==0 && TransparentHugePagesEnabled())
+        mode=kTransparentHugePages;
+#endif
+    return start;
+}
+
+void LargeFree(void* p, size_t size) {
+    if (p)
+        munmap(p, HugePageRound(size));
+}
+
+void* MapFile(const char* fn, size_t& size) {
+    const int fd=open(fn, O_RDONLY);
+    if (fd<0)
+        return NULL;
+    struct stat st;
+    void* p=NULL;
+    if (fstat(fd, &st)==0 && st.st_size>0) {
+        size=size_t(st.st_size);
+        p=mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p==MAP_FAILED)
+            p=NULL;
+    }
+    close(fd);
+    return p;
+}
+
+void UnmapFile(void* p, size_t size) {
+    if (p)
+        munmap(p, size);
+}
+
+#endif // _WIN32
+
+const char* PageModeName(TPageMode mode) {
+    switch(mode) {
+    case kHugePages:
+        return "huge pages";
+    case kTransparentHugePages:
+        return "transparent huge pages";
+    default:
+        return "normal pages";
+    }
+}
@@ -190,3 +190,16 @@ inline u64 hash_mover_empty(u64 mover, u64 empty) {
 
 i8 GetTicks(void);
 i8 GetTicksPerSecond(void);
+
+// Allocation of large, randomly accessed tables (the cache, evaluator coefficients).
+// Memory is backed by huge pages when the OS provides them, to reduce TLB misses,
+// and is zeroed and aligned to at least 64 bytes.
+enum TPageMode { kHugePages, kTransparentHugePages, kNormalPages };
+void* LargeAlloc(size_t size, TPageMode& mode);
+void LargeFree(void* p, size_t size);
+const char* PageModeName(TPageMode mode);
+
+// Map a file into memory, copy-on-write: changes to the memory are not written to the file.
+// Return NULL if the file can't be mapped.
+void* MapFile(const char* fn, size_t& size);
+void UnmapFile(void* p, size_t size);
@@ -14,6 +14,7 @@
 #include <iomanip>
 #include <string>
 #include "n64/n64.h"
+#include "n64/solve.h"
 #include "n64/test.h"
 #include "core/NodeStats.h"
 #include "core/CalcParams.h"
@@ -51,6 +52,10 @@ void Init() {
     void InitFFBonus();
     InitFFBonus();
     InitForcedOpenings();
+    InitCacheOptions();
+    uint64_t solverHashBytes=HashTable::defaultBytes;
+    InitMemSize("NTEST_SOLVER_HASH_BYTES", solverHashBytes);
+    SetSolverHashBytes(solverHashBytes);
 }
 
 void Clean() {
@@ -68,6 +73,7 @@ void Test() {
     TestPos2();
     TestSearch();
     GoldenValueEvalTest();
+    EvalMobsImplementationTest();
     std::cerr << "Ending standard test" << std::endl;
 }
 
@@ -89,7 +95,46 @@ int main(int argc, char**argv, char**envp) {
 
       start.Read();
 
-      TestMoveSpeed(18, 16);
+      if (argc>1 && !strcmp(argv[1], "n64")) {
+        // speed_test n64 <command> - run an n64 solver command, e.g. timeSolves
+        // order moves near the root with the players' default evaluator
+        evaluator=CEvaluator::FindEvaluator('J','A');
+        setOrderingEval(SolverOrderingEval, solverOrderingMinEmpties);
+        int n64_main(int argc, char* argv[]);
+        n64_main(argc-1, argv+1);
+      }
+      else if (argc>1 && !strcmp(argv[1], "threads")) {
+        // speed_test threads [height [nGames]]
+        const int height=argc>2 ? atoi(argv[2]) : 16;
+        const int nGames=argc>3 ? atoi(argv[3]) : 1000;
+        TestParallelSpeed(height, nGames);
+      }
+      else if (argc>1 && !strcmp(argv[1], "stable")) {
+        // speed_test stable [endDepth [midDepth]]
+        const int endDepth=argc>2 ? atoi(argv[2]) : 18;
+        const int midDepth=argc>3 ? atoi(argv[3]) : 16;
+        TestStableSpeed(endDepth, midDepth);
+      }
+      else if (argc>1 && !strcmp(argv[1], "patterns")) {
+        // speed_test patterns [endDepth [midDepth]]
+        const int endDepth=argc>2 ? atoi(argv[2]) : 18;
+        const int midDepth=argc>3 ? atoi(argv[3]) : 16;
+        TestPatternSpeed(endDepth, midDepth);
+      }
+      else if (argc>1 && !strcmp(argv[1], "eval")) {
+        // speed_test eval [nRepeats]
+        const int nRepeats=argc>2 ? atoi(argv[2]) : 100;
+        TestEvalSpeed(nRepeats);
+      }
+      else if (argc>1 && !strcmp(argv[1], "falsehits")) {
+        // speed_test falsehits [height [nGames]]
+        const int height=argc>2 ? atoi(argv[2]) : 16;
+        const int nGames=argc>3 ? atoi(argv[3]) : 1000;
+        TestCacheFalseHits(height, nGames);
+      }
+      else {
+        TestMoveSpeed(18, 16);
+      }
 
       time(&end_time);
       end.Read();